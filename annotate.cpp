@@ -0,0 +1,291 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// annotate.cpp                                                               //
+//                                                                            //
+// Annotate the games in a PGN file. Each game is analyzed from its last      //
+// position back to its first by a single engine, so that the transposition   //
+// table filled while searching later positions informs the search of         //
+// earlier ones. Moves which lose too much against the engine's choice are    //
+// marked and the better line is given as a variation. Games are spread over  //
+// worker threads and written in input order.                                 //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chesley.hpp"
+#include "pipeline.hpp"
+
+using namespace std;
+
+// Format a score from white's point of view in pawns, or as a mate
+// distance in moves.
+static string
+format_score (Score s) {
+  char buf[32];
+  if (is_mate (s))
+    {
+      int moves = (MATE_VAL - abs (s) + 1) / 2;
+      snprintf (buf, sizeof (buf), "%sM%i", s > 0 ? "+" : "-", moves);
+    }
+  else
+    {
+      snprintf (buf, sizeof (buf), "%+.2f", s / 100.0);
+    }
+  return buf;
+}
+
+// Write a move played from b in SAN with its move number.
+static string
+move_token (const Board &b, Move m) {
+  ostringstream s;
+  s << max ((int) b.full_move_clock, 1)
+    << (b.to_move () == WHITE ? ". " : "... ")
+    << b.to_san (m);
+  return s.str ();
+}
+
+// Collects move text tokens and wraps them into lines.
+struct Move_Text {
+
+  Move_Text () : column (0) {}
+
+  void add (const string &token) {
+    if (column > 0 && column + 1 + token.length () > 79)
+      {
+        s << "\n";
+        column = 0;
+      }
+    else if (column > 0)
+      {
+        s << " ";
+        column++;
+      }
+    s << token;
+    column += token.length ();
+  }
+
+  ostringstream s;
+  size_t column;
+};
+
+struct Annotator : public Pipeline <Game> {
+
+  Annotator (int nthreads, FILE *out, int depth, int margin) :
+    Pipeline <Game> (nthreads, out), depth (depth), margin (margin) {}
+
+  // Configure a worker's engine for a fixed depth search.
+  void init_engine (Search_Engine &se) {
+    se.controls.mode = UNLIMITED;
+    se.set_fixed_depth (depth);
+  }
+
+  // Analyze and write one game.
+  string process (Search_Engine &se, const Game &g) {
+    try
+      {
+        return annotate (se, g);
+      }
+    catch (string e)
+      {
+        return "{ Error annotating game: " + e + " }\n\n";
+      }
+  }
+
+  string annotate (Search_Engine &se, const Game &g) {
+    map <string, string> tags (g.metadata);
+    size_t n = g.moves.size ();
+
+    // Replay the game, recording each position.
+    vector <Board> boards;
+    if (tags.find ("FEN") != tags.end ())
+      boards.push_back (Board::from_fen (tags["FEN"]));
+    else
+      boards.push_back (Board::startpos ());
+
+    Search_Engine::Rep_Table history;
+    for (size_t i = 0; i < n; i++)
+      {
+        Board b = boards.back ();
+        if (!b.apply (g.moves[i]))
+          throw string ("illegal move in game");
+        boards.push_back (b);
+        history[b.hash]++;
+      }
+
+    // Analyze each position from the end of the game back to the
+    // beginning. The repetition table holds every position up to and
+    // including the one being searched.
+    vector <Score> score (n + 1);
+    vector <Move_Vector> pv (n + 1);
+    se.tt.clear ();
+
+    for (size_t i = n + 1; i-- > 0;)
+      {
+        const Board &b = boards[i];
+        se.rt = history;
+
+        if (b.child_count () == 0)
+          score[i] = b.in_check (b.to_move ()) ? -MATE_VAL : 0;
+        else if (se.is_triple_rep (b))
+          score[i] = 0;
+        else
+          score[i] = se.compute_pv (b, MAX_DEPTH, pv[i]);
+
+        if (i > 0 && --history[b.hash] == 0)
+          history.erase (b.hash);
+      }
+
+    // Write the tags, the seven tag roster first.
+    ostringstream s;
+    const char *roster[] =
+      { "Event", "Site", "Date", "Round", "White", "Black", "Result" };
+    for (int i = 0; i < 7; i++)
+      {
+        s << "[" << roster[i] << " \"" << tags[roster[i]] << "\"]\n";
+        tags.erase (roster[i]);
+      }
+    tags["Annotator"] = "Chesley";
+    for (map <string, string>::iterator i = tags.begin ();
+         i != tags.end (); i++)
+      s << "[" << i -> first << " \"" << i -> second << "\"]\n";
+    s << "\n";
+
+    // Write the annotated moves. Scores are from white's point of view
+    // and every move is numbered since each is followed by a comment.
+    Move_Text text;
+
+    for (size_t i = 0; i < n; i++)
+      {
+        const Board &b = boards[i];
+        Move m = g.moves[i];
+        int sign = b.to_move () == WHITE ? 1 : -1;
+
+        // The score of the position after the played move, from the
+        // mover's point of view, against the score of the best move.
+        Score played = -score[i + 1];
+        Score best = score[i];
+        bool is_best = pv[i].count == 0 || pv[i][0] == m;
+        int drop = is_best ? 0 : best - played;
+
+        // Mark a bad move and give the score after it, unless the
+        // game is over.
+        string nag = drop >= 3 * margin ? "??" : drop >= margin ? "?" : "";
+        text.add (move_token (b, m) + nag);
+        if (pv[i + 1].count > 0)
+          text.add ("{" + format_score (sign * played) + "}");
+
+        // Give the engine's line as an alternative to a bad move.
+        if (drop >= margin)
+          {
+            Board c = b;
+            for (int j = 0; j < pv[i].count; j++)
+              {
+                if (j == 0)
+                  text.add ("(" + move_token (c, pv[i][j]));
+                else if (c.to_move () == WHITE)
+                  text.add (move_token (c, pv[i][j]));
+                else
+                  text.add (c.to_san (pv[i][j]));
+                if (!c.apply (pv[i][j]))
+                  break;
+              }
+            text.add ("{" + format_score (sign * best) + "})");
+          }
+      }
+
+    text.add (g.metadata.count ("Result") ?
+              g.metadata.find ("Result") -> second : "*");
+    s << text.s.str () << "\n\n";
+
+    return s.str ();
+  }
+
+  const int depth;
+  const int margin;
+};
+
+///////////////////////////////////////////////////////////////
+// Annotate a PGN file. Usage:                               //
+//                                                           //
+//   annotate <pgn> [out <file>] [depth <d>] [margin <cp>]   //
+//            [threads <t>]                                  //
+///////////////////////////////////////////////////////////////
+
+bool
+Session::annotate (const string_vector &tokens) {
+  string in_name, out_name;
+  int depth = 6;
+  int margin = 100;
+  int threads = max ((int) thread::hardware_concurrency (), 1);
+
+  if (tokens.size () < 2)
+    {
+      fprintf (out, "Usage: annotate <pgn> [out <file>] [depth <d>] "
+               "[margin <cp>] [threads <t>]\n");
+      return false;
+    }
+
+  in_name = tokens[1];
+  for (size_t i = 2; i + 1 < tokens.size (); i += 2)
+    {
+      if (tokens[i] == "out")
+        out_name = tokens[i + 1];
+      else if (tokens[i] == "depth")
+        depth = to_int (tokens[i + 1]);
+      else if (tokens[i] == "margin")
+        margin = to_int (tokens[i + 1]);
+      else if (tokens[i] == "threads")
+        threads = to_int (tokens[i + 1]);
+    }
+
+  PGN pgn;
+  pgn.open (in_name.c_str ());
+  if (pgn.status == PGN::FATAL_ERROR)
+    {
+      fprintf (out, "Error: could not open %s\n", in_name.c_str ());
+      return false;
+    }
+
+  FILE *fp = out;
+  if (!out_name.empty () && !(fp = fopen (out_name.c_str (), "w")))
+    {
+      fprintf (out, "Error: could not open %s\n", out_name.c_str ());
+      pgn.close ();
+      return false;
+    }
+
+  uint64 start = mclock ();
+  Annotator annotator (threads, fp, max (depth, 1), max (margin, 1));
+  annotator.start ();
+
+  // Queue each game which was read successfully.
+  while (true)
+    {
+      Game g = pgn.read_game ();
+      if (pgn.status == PGN::END_OF_FILE || pgn.status == PGN::FATAL_ERROR)
+        break;
+      if (pgn.status == PGN::OK)
+        annotator.push (g);
+    }
+
+  annotator.finish ();
+  pgn.close ();
+  if (fp != out)
+    fclose (fp);
+
+  fprintf (out, "Annotated %llu games in %.2f seconds.\n",
+           (unsigned long long) annotator.jobs_done,
+           (mclock () - start) / 1000.0);
+
+  return true;
+}
@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// batch.cpp                                                                  //
+//                                                                            //
+// Batch analysis of a stream of positions read from standard input. Each     //
+// worker thread owns an independent search engine and hash tables and        //
+// results are written in input order.                                        //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "chesley.hpp"
+#include "pipeline.hpp"
+
+using namespace std;
+
+// Search each position in a stream of FEN or EPD lines.
+struct Batch : public Pipeline <string> {
+
+  Batch (int nthreads, int64 nodes, int depth, const string &shm) :
+    Pipeline <string> (nthreads, stdout), nodes (nodes), depth (depth),
+    shm (shm), tt_hits (0), shared_hits (0) {}
+
+  // Configure a worker's engine for node and/or depth limited search,
+  // attaching it to the shared transposition table if there is one.
+  void init_engine (Search_Engine &se) {
+    se.controls.mode = UNLIMITED;
+    se.set_fixed_nodes (nodes);
+    se.set_fixed_depth (depth);
+
+    if (shm.length () > 0)
+      {
+        try
+          {
+            se.tt.attach (shm.c_str (), se.tt.sz);
+          }
+        catch (string e)
+          {
+            fprintf (stderr, "%s\n", e.c_str ());
+          }
+      }
+  }
+
+  // Search a single position and format the result as:
+  //
+  //   move <calg> score <cp> depth <ply> nodes <n> pv <calg> ...
+  //
+  // or "error <message>" if the line could not be searched.
+  string process (Search_Engine &se, const string &line) {
+    ostringstream s;
+
+    try
+      {
+        Board b = Board::from_fen (line);
+        Move_Vector pv;
+        Score score;
+
+        if (!b.is_valid ())
+          return "error illegal position\n";
+
+        // There is nothing to search if the game is over.
+        if (b.child_count () == 0)
+          {
+            score = b.in_check (b.to_move ()) ? -MATE_VAL : 0;
+            s << "move none score " << score << " depth 0 nodes 0 pv\n";
+            return s.str ();
+          }
+
+        score = se.compute_pv (b, MAX_DEPTH, pv);
+        s << se.summary (b, score, pv) << "\n";
+
+        // The engine's statistics are cleared by each search.
+        unique_lock <mutex> lock (stats_m);
+        tt_hits += se.tt.hits;
+        shared_hits += se.tt.shared_hits;
+      }
+    catch (string e)
+      {
+        return "error " + e + "\n";
+      }
+
+    return s.str ();
+  }
+
+  const int64 nodes;
+  const int depth;
+  const string shm;
+
+  // Transposition table hits over every search, and how many of them
+  // were on entries written by other processes.
+  uint64 tt_hits;
+  uint64 shared_hits;
+  mutex stats_m;
+};
+
+// Entry point for "chesley batch".
+int
+batch_main (int argc, char **argv) {
+  int threads = 1;
+  int64 nodes = -1;
+  int depth = -1;
+  string shm;
+  bool shm_unlink = false;
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      if (arg == "--nodes" && i + 1 < argc)
+        {
+          nodes = atoll (argv[++i]);
+        }
+      else if (arg == "--depth" && i + 1 < argc)
+        {
+          depth = atoi (argv[++i]);
+        }
+      else if (arg == "--threads" && i + 1 < argc)
+        {
+          threads = atoi (argv[++i]);
+        }
+      else if (arg == "--shm" && i + 1 < argc)
+        {
+          shm = argv[++i];
+        }
+      else if (arg == "--shm-unlink")
+        {
+          shm_unlink = true;
+        }
+      else if (arg == "--numa" && i + 1 < argc &&
+               parse_numa_policy (argv[i + 1], numa_policy))
+        {
+          i++;
+        }
+      else if (arg == "--pin" && i + 1 < argc &&
+               parse_numa_pin (argv[i + 1], numa_pin))
+        {
+          i++;
+        }
+      else
+        {
+          fprintf (stderr, "usage: %s batch [--nodes N] [--depth D] "
+                   "[--threads T] [--shm NAME [--shm-unlink]] "
+                   "[--numa default|interleave|local] "
+                   "[--pin none|core|node]\n", arg0);
+          return 1;
+        }
+    }
+
+  // Without a limit every search would run forever.
+  if (nodes <= 0 && depth <= 0)
+    depth = 6;
+
+  uint64 start = mclock ();
+  Batch batch (threads, nodes, depth, shm);
+  batch.start ();
+
+  // Queue each non-blank line of input.
+  while (char *line = get_line (stdin))
+    {
+      string fen = trim (line);
+      free (line);
+      if (fen.length () > 0)
+        batch.push (fen);
+    }
+
+  batch.finish ();
+
+  // Processes still attached to the segment keep their mappings.
+  if (shm_unlink && shm.length () > 0)
+    TTable::unlink (shm.c_str ());
+
+  // Report throughput, and for a shared table how much it was shared.
+  double elapsed = (mclock () - start) / 1000.0;
+  fprintf (stderr, "%llu positions in %.2f seconds, %.1f positions/sec",
+           (unsigned long long) batch.jobs_done, elapsed,
+           elapsed > 0 ? batch.jobs_done / elapsed : 0.0);
+  if (shm.length () > 0)
+    fprintf (stderr, ", %llu of %llu hits from other processes",
+             (unsigned long long) batch.shared_hits,
+             (unsigned long long) batch.tt_hits);
+  fprintf (stderr, "\n");
+
+  return 0;
+}
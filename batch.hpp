@@ -0,0 +1,28 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// batch.hpp                                                                  //
+//                                                                            //
+// Batch analysis of a stream of positions read from standard input.          //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BATCH_
+#define _BATCH_
+
+// Entry point for "chesley batch [--nodes N] [--depth D] [--threads
+// T] [--shm NAME [--shm-unlink]]". Each line of standard input is a
+// FEN or EPD position and one line of results is written to standard
+// output for each, in input order. With --shm every engine uses the
+// transposition table in the named shared memory segment, which
+// outlives the process unless --shm-unlink is given. The last of a
+// group of processes sharing a table should pass it, or the segment
+// may be removed with "SHM unlink NAME" or from /dev/shm. --numa and
+// --pin set the placement of the engines' tables and of the worker
+// threads.
+int batch_main (int argc, char **argv);
+
+#endif // _BATCH_
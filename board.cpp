@@ -130,6 +130,9 @@ Board::common_init (Board &b) {
   b.hash = 0x0;
   b.phash = 0x0;
 
+  // No check state has been computed.
+  b.check_key = ~b.hash;
+
   // White is to move.
   b.hash ^= zobrist_key_white_to_move;
   b.phash ^= zobrist_key_white_to_move;
@@ -216,7 +219,7 @@ Board::clear_piece (Coord idx) {
     }
 }
 
-void
+template <Apply_Policy P> void
 Board::clear_piece (Kind k, Color c, Coord idx) {
 
   if (occupied & masks_0[idx])
@@ -232,7 +235,8 @@ Board::clear_piece (Kind k, Color c, Coord idx) {
       kind_to_board (k) &= ~mask;
 
       // Update hash key.
-      hash ^= get_zobrist_piece_key (c, k, idx);
+      if (P == APPLY_FULL)
+        hash ^= get_zobrist_piece_key (c, k, idx);
 
       // Update evaluation information.
       material[c] -= value (k);
@@ -242,11 +246,14 @@ Board::clear_piece (Kind k, Color c, Coord idx) {
       cout << psquares[c][OPENING_PHASE] << endl;
 #endif
 
-      psquares[c][OPENING_PHASE] -=
-        piece_square_value (OPENING_PHASE, k, c, idx);
+      if (P == APPLY_FULL)
+        {
+          psquares[c][OPENING_PHASE] -=
+            piece_square_value (OPENING_PHASE, k, c, idx);
 
-      psquares[c][END_PHASE] -=
-        piece_square_value (END_PHASE, k, c, idx);
+          psquares[c][END_PHASE] -=
+            piece_square_value (END_PHASE, k, c, idx);
+        }
 
 #if 0
       cout << psquares[c][OPENING_PHASE] << endl;
@@ -257,8 +264,10 @@ Board::clear_piece (Kind k, Color c, Coord idx) {
       // Check the special case of clearing a pawn.
       if (k == PAWN)
         {
-          phash ^= get_zobrist_piece_key (c, k, idx);
-          pawn_counts[c][idx_to_file (idx)]--;
+          if (P == APPLY_FULL)
+            phash ^= get_zobrist_piece_key (c, k, idx);
+          if (P != APPLY_PLACEMENT)
+            pawn_counts[c][idx_to_file (idx)]--;
         }
 
       // Clear the occupancy sets.
@@ -270,7 +279,7 @@ Board::clear_piece (Kind k, Color c, Coord idx) {
 }
 
 // Set a piece on the board with an index.
-void
+template <Apply_Policy P> void
 Board::set_piece (Kind k, Color c, Coord idx) {
   assert (~occupied & masks_0[idx]);
   assert (k != NULL_KIND);
@@ -282,8 +291,11 @@ Board::set_piece (Kind k, Color c, Coord idx) {
   kind_to_board (k) |= masks_0[idx];
 
   // Update hash key.
-  hash ^= get_zobrist_piece_key (c, k, idx);
-  if (k == PAWN) phash ^= get_zobrist_piece_key (c, k, idx);
+  if (P == APPLY_FULL)
+    {
+      hash ^= get_zobrist_piece_key (c, k, idx);
+      if (k == PAWN) phash ^= get_zobrist_piece_key (c, k, idx);
+    }
 
   // Update evaluation information.
   material[c] += value (k);
@@ -294,18 +306,21 @@ Board::set_piece (Kind k, Color c, Coord idx) {
   cout << "Adding..." << endl;
 #endif
 
-  psquares[c][OPENING_PHASE] +=
-    piece_square_value (OPENING_PHASE, k, c, idx);
+  if (P == APPLY_FULL)
+    psquares[c][OPENING_PHASE] +=
+      piece_square_value (OPENING_PHASE, k, c, idx);
 
 #if 0
   cout << psquares[c][OPENING_PHASE] << endl;
 #endif
 
-  psquares[c][END_PHASE] +=
-    piece_square_value (END_PHASE, k, c, idx);
+  if (P == APPLY_FULL)
+    psquares[c][END_PHASE] +=
+      piece_square_value (END_PHASE, k, c, idx);
 
   piece_counts[c][k]++;
-  if (k == PAWN) pawn_counts[c][idx_to_file (idx)]++;
+  if (P != APPLY_PLACEMENT && k == PAWN)
+    pawn_counts[c][idx_to_file (idx)]++;
 
   // Update occupancy sets.
   occupied |= masks_0[idx];
@@ -320,26 +335,31 @@ Board::set_piece (Kind k, Color c, int rank, int file) {
   set_piece (k, c, to_idx (rank, file));
 }
 
+template void Board::clear_piece <APPLY_FULL> (Kind, Color, Coord);
+template void Board::set_piece <APPLY_FULL> (Kind, Color, Coord);
+
 //////////////////////
 // Move application //
 //////////////////////
 
 // Apply a move to the board. Return false if this move is illegal
 // because it places or leaves the color to move in check.
-bool
-Board::apply (const Move &m) {
-  Undo dummy;
-  return apply (m, dummy);
-}
-
-bool
-Board::apply (const Move &m, Undo &u) {
+template <Apply_Policy P> bool
+Board::apply_move (const Move &m, Undo &u) {
   const Kind kind = m.get_kind ();
   const Kind capture = m.get_capture ();
   const Color color = to_move ();
 
   if (capture == KING) return false;
 
+  // If the check state of this position is already known, a move by a
+  // piece which is not pinned cannot leave its king in check unless
+  // the king is already in check, it is the king which moves or it is
+  // an en passant capture, which removes a second piece from the board.
+  const bool known_legal = P == APPLY_PLACEMENT ||
+    (check_key == hash && !checkers_bb && kind != KING &&
+     !m.is_en_passant () && !(pinned_bb & masks_0[m.from]));
+
   ///////////////////////////
   // Save undo information //
   ///////////////////////////
@@ -389,11 +409,11 @@ Board::apply (const Move &m, Undo &u) {
         {
           if (color == WHITE)
             {
-              clear_piece (PAWN, BLACK, flags.en_passant - 8);
+              clear_piece <P> (PAWN, BLACK, flags.en_passant - 8);
             }
           else
             {
-              clear_piece (PAWN, WHITE, flags.en_passant + 8);
+              clear_piece <P> (PAWN, WHITE, flags.en_passant + 8);
             }
         }
 
@@ -454,16 +474,15 @@ Board::apply (const Move &m, Undo &u) {
               // Handle castling moves //
               ///////////////////////////
 
-              const bitboard attacked = attack_set (invert (color));
+              const bitboard attacked =
+                P == APPLY_PLACEMENT ? 0 : attack_set (invert (color));
 
               if (color == WHITE)
                 {
                   if (is_castle_qs)
                     {
-                      clear_piece (KING, WHITE, E1);
-                      clear_piece (ROOK, WHITE, A1);
-                      set_piece (KING, WHITE, C1);
-                      set_piece (ROOK, WHITE, D1);
+                      move_piece <P> (KING, WHITE, E1, C1);
+                      move_piece <P> (ROOK, WHITE, A1, D1);
                       set_color (invert (to_move ()));
                       flags.w_has_q_castled = 1;
                       return !(attacked & 0x1C);
@@ -471,10 +490,8 @@ Board::apply (const Move &m, Undo &u) {
 
                   if (is_castle_ks)
                     {
-                      clear_piece (KING, WHITE, E1);
-                      clear_piece (ROOK, WHITE, H1);
-                      set_piece (KING, WHITE, G1);
-                      set_piece (ROOK, WHITE, F1);
+                      move_piece <P> (KING, WHITE, E1, G1);
+                      move_piece <P> (ROOK, WHITE, H1, F1);
                       set_color (invert (to_move ()));
                       flags.w_has_k_castled = 1;
                       return !(attacked & 0x70);
@@ -486,10 +503,8 @@ Board::apply (const Move &m, Undo &u) {
 
                   if (is_castle_qs)
                     {
-                      clear_piece (KING, BLACK, E8);
-                      clear_piece (ROOK, BLACK, A8);
-                      set_piece (KING, BLACK, C8);
-                      set_piece (ROOK, BLACK, D8);
+                      move_piece <P> (KING, BLACK, E8, C8);
+                      move_piece <P> (ROOK, BLACK, A8, D8);
                       set_color (invert (to_move ()));
                       flags.b_has_q_castled = 1;
                       return !(attacks & 0x1C);
@@ -497,10 +512,8 @@ Board::apply (const Move &m, Undo &u) {
 
                   if (is_castle_ks)
                     {
-                      clear_piece (KING, BLACK, E8);
-                      clear_piece (ROOK, BLACK, H8);
-                      set_piece (KING, BLACK, G8);
-                      set_piece (ROOK, BLACK, F8);
+                      move_piece <P> (KING, BLACK, E8, G8);
+                      move_piece <P> (ROOK, BLACK, H8, F8);
                       set_color (invert (to_move ()));
                       flags.b_has_k_castled = 1;
                       return !(attacks & 0x70);
@@ -534,30 +547,38 @@ Board::apply (const Move &m, Undo &u) {
 
   set_color (~to_move ());
 
-  //////////////////////////////////////////////
-  // Clear the origin and destination squares //
-  //////////////////////////////////////////////
+  /////////////////////////////////////
+  // Remove any piece being captured //
+  /////////////////////////////////////
 
-  clear_piece (kind, color, m.from);
   if (capture != NULL_KIND)
-    clear_piece (capture, ~color, m.to);
+    clear_piece <P> (capture, ~color, m.to);
 
-  ////////////////////////////////////////////////////
-  // Set the destination square, possibly promoting //
-  ////////////////////////////////////////////////////
+  ///////////////////////////////////////////
+  // Move the piece, possibly promoting it //
+  ///////////////////////////////////////////
 
-  Kind destination_kind = kind;
-  if (m.promote != NULL_KIND) destination_kind = m.promote;
-
-  set_piece (destination_kind, color, m.to);
+  if (m.promote == NULL_KIND)
+    {
+      move_piece <P> (kind, color, m.from, m.to);
+    }
+  else
+    {
+      clear_piece <P> (kind, color, m.from);
+      set_piece <P> (m.promote, color, m.to);
+    }
 
   /////////////////////////////////////////////
   // Test legality of the resulting position //
   /////////////////////////////////////////////
 
-  return !in_check (color);
+  return known_legal || !in_check (color);
 }
 
+template bool Board::apply_move <APPLY_FULL> (const Move &, Undo &);
+template bool Board::apply_move <APPLY_NO_HASH> (const Move &, Undo &);
+template bool Board::apply_move <APPLY_PLACEMENT> (const Move &, Undo &);
+
 void
 Board::unapply (const Move &m, const Undo &u) {
 
@@ -610,19 +631,15 @@ Board::unapply (const Move &m, const Undo &u) {
             {
               if (is_castle_qs)
                 {
-                  set_piece (KING, WHITE, E1);
-                  set_piece (ROOK, WHITE, A1);
-                  clear_piece (KING, WHITE, C1);
-                  clear_piece (ROOK, WHITE, D1);
+                  move_piece (KING, WHITE, C1, E1);
+                  move_piece (ROOK, WHITE, D1, A1);
                   set_color (invert (to_move ()));
                   return;
                 }
               if (is_castle_ks)
                 {
-                  set_piece (KING, WHITE, E1);
-                  set_piece (ROOK, WHITE, H1);
-                  clear_piece (KING, WHITE, G1);
-                  clear_piece (ROOK, WHITE, F1);
+                  move_piece (KING, WHITE, G1, E1);
+                  move_piece (ROOK, WHITE, F1, H1);
                   set_color (invert (to_move ()));
                   return;
                 }
@@ -631,19 +648,15 @@ Board::unapply (const Move &m, const Undo &u) {
             {
               if (is_castle_qs)
                 {
-                  set_piece (KING, BLACK, E8);
-                  set_piece (ROOK, BLACK, A8);
-                  clear_piece (KING, BLACK, C8);
-                  clear_piece (ROOK, BLACK, D8);
+                  move_piece (KING, BLACK, C8, E8);
+                  move_piece (ROOK, BLACK, D8, A8);
                   set_color (invert (to_move ()));
                   return;
                 }
               if (is_castle_ks)
                 {
-                  set_piece (KING, BLACK, E8);
-                  set_piece (ROOK, BLACK, H8);
-                  clear_piece (KING, BLACK, G8);
-                  clear_piece (ROOK, BLACK, F8);
+                  move_piece (KING, BLACK, G8, E8);
+                  move_piece (ROOK, BLACK, F8, H8);
                   set_color (invert (to_move ()));
                   return;
                 }
@@ -657,29 +670,43 @@ Board::unapply (const Move &m, const Undo &u) {
 
   set_color (invert (to_move ()));
 
-  ////////////////////////////////////
-  // Restore the destination square //
-  ////////////////////////////////////
+  //////////////////////////////////////////////////
+  // Move the piece back, possibly unpromoting it //
+  //////////////////////////////////////////////////
 
   if (m.is_promote ())
     {
       clear_piece (m.get_promote (), m.get_color (), m.to);
+      set_piece (m.get_kind (), m.get_color (), m.from);
     }
   else
     {
-      clear_piece (m.get_kind (), m.get_color (), m.to);
+      move_piece (m.get_kind (), m.get_color (), m.to, m.from);
     }
 
+  ////////////////////////////////
+  // Restore any piece captured //
+  ////////////////////////////////
+
   if (m.is_capture () && !m.is_en_passant ())
     {
       set_piece (m.capture, ~m.get_color (), m.to);
     }
+}
 
-  ///////////////////////////////
-  // Restore the origin square //
-  ///////////////////////////////
+// Pass the move to the other side, saving the en passant target in u.
+void
+Board::apply_null (Undo &u) {
+  u.en_passant = flags.en_passant;
+  set_en_passant (0);
+  set_color (invert (to_move ()));
+}
 
-  set_piece (m.get_kind (), m.get_color (), m.from);
+// Take back a null move.
+void
+Board::unapply_null (const Undo &u) {
+  set_color (invert (to_move ()));
+  set_en_passant (u.en_passant);
 }
 
 /////////////
@@ -724,6 +751,36 @@ Board::print_tree (int depth)
     }
 }
 
+// Recompute everything a replay policy lighter than APPLY_FULL leaves
+// stale from the placement of the pieces.
+void
+Board::resync () {
+  hash = gen_hash ();
+  phash = to_move () == WHITE ? zobrist_key_white_to_move : 0;
+  check_key = ~hash;
+  ZERO (psquares);
+  ZERO (pawn_counts);
+
+  for (Coord i = 0; i < 64; i++)
+    {
+      Kind k = get_kind (i);
+      Color c = get_color (i);
+      if (k == NULL_KIND || c == NULL_COLOR)
+        continue;
+
+      psquares[c][OPENING_PHASE] +=
+        piece_square_value (OPENING_PHASE, k, c, i);
+      psquares[c][END_PHASE] +=
+        piece_square_value (END_PHASE, k, c, i);
+
+      if (k == PAWN)
+        {
+          phash ^= get_zobrist_piece_key (c, k, i);
+          pawn_counts[c][idx_to_file (i)]++;
+        }
+    }
+}
+
 // Generate a hash key from scratch. This is used to test the
 // correctness of our incremental hash update code.
 uint64
@@ -30,6 +30,20 @@
 struct Move_Vector;
 struct Board;
 
+// The number of times this thread has computed the attacks on a king,
+// for measuring the cost of check and legality tests.
+extern thread_local uint64 king_attack_tests;
+
+// How much of the state of a board is maintained when a move is
+// applied. The lighter policies are for replaying games, where the
+// moves are already known to be legal or only the placement of the
+// pieces is wanted. Board::resync restores what they leave stale.
+enum Apply_Policy {
+  APPLY_FULL,      // Everything, as the search requires.
+  APPLY_NO_HASH,   // No hash keys or piece square scores.
+  APPLY_PLACEMENT  // Only pieces, material and flags, and no legality test.
+};
+
 ////////////////////////////
 // Chess board state type //
 ////////////////////////////
@@ -88,8 +102,9 @@ struct Board {
   // Construct from an ASCII board representation.
   static Board from_ascii  (const std::string &str);
 
-  // Construct from a FEN or EPD string.
-  static Board from_fen (const std::string &fen, bool EPD = false);
+  // Construct from a FEN or EPD string. The string is parsed in place
+  // without allocating.
+  static Board from_fen (String_View fen, bool EPD = false);
   static Board from_fen (const string_vector &toks, bool EPD = false);
 
   // Construct a board from the standard starting position.
@@ -115,6 +130,13 @@ struct Board {
   uint64 hash;
   uint64 phash;
 
+  // The check state of the side to move, computed on demand by
+  // compute_check_state and valid while check_key is equal to hash.
+  // Copies of a board share the state until either one changes.
+  mutable uint64   check_key;
+  mutable bitboard checkers_bb;
+  mutable bitboard pinned_bb;
+
   ////////////
   // Output //
   ////////////
@@ -144,6 +166,11 @@ struct Board {
   // Construct a Move from coordinate algebraic notation.
   Move from_calg (const std::string &s) const;
 
+  // Find the legal move written as s in coordinate algebraic notation,
+  // or return NULL_MOVE if there is none. Unlike from_calg this is
+  // safe to use on untrusted input.
+  Move legal_from_calg (const std::string &s) const;
+
   // Return a description of a Move in coordinate algebraic notation.
   std::string to_calg (const Move &m) const;
 
@@ -178,9 +205,57 @@ struct Board {
   // attacking a square.
   Move least_valuable_attacker (Coord sqr) const;
 
+  // Return the pieces of color c attacking the square idx.
+  bitboard attackers (Coord idx, Color c) const;
+
   // Return whether color c is in check.
   bool in_check (Color c) const;
 
+  // Return the pieces giving check to the side to move.
+  bitboard checkers () const {
+    if (check_key != hash)
+      compute_check_state ();
+    return checkers_bb;
+  }
+
+  // Return the pieces of the side to move which are pinned against
+  // its king.
+  bitboard pinned () const {
+    if (check_key != hash)
+      compute_check_state ();
+    return pinned_bb;
+  }
+
+  // Compute checkers and pinned pieces for the side to move.
+  void compute_check_state () const;
+
+  // Return whether a pseudo-legal move for the side to move is legal,
+  // without making it when the cached check state settles the matter.
+  bool is_legal (const Move &m) const;
+
+  // What the side to move needs to know to recognize its checking
+  // moves: the squares from which each kind of piece would attack the
+  // enemy king, and the pieces whose moves may uncover an attack on it
+  // by a slider behind them.
+  struct Check_Info {
+    Check_Info (const Board &b);
+    bitboard squares[KIND_COUNT];
+    bitboard discoverers;
+    Coord ksq;
+  };
+
+  // Return whether a move by the side to move gives check, without
+  // making it.
+  bool gives_check (const Move &m, const Check_Info &ci) const;
+
+  bool gives_check (const Move &m) const {
+    return gives_check (m, Check_Info (*this));
+  }
+
+  // Return whether this is a position which can be searched: each side
+  // has exactly one king and the side not to move is not in check.
+  bool is_valid () const;
+
   // Return the color to move.
   Color to_move () const { return flags.to_move; }
 
@@ -464,17 +539,84 @@ struct Board {
 
   // Clear a piece on the board.
   void clear_piece (Coord idx);
+  template <Apply_Policy P = APPLY_FULL>
   void clear_piece (Kind k, Color c, Coord idx);
 
   // Set a piece on the board.
+  template <Apply_Policy P = APPLY_FULL>
   void set_piece (Kind k, Color c, Coord idx);
   void set_piece (Kind k, Color c, int row, int file);
 
-  // Apply a move to this board.
-  bool apply (const Move &m);
-  bool apply (const Move &m, Undo &u);
+  // Move a piece to an empty square. This is equivalent to clearing it
+  // and setting it again, but material and piece counts are untouched
+  // and the hash and piece square scores are updated by a single
+  // lookup each in the move delta tables.
+  template <Apply_Policy P = APPLY_FULL>
+  void move_piece (Kind k, Color c, Coord from, Coord to) {
+    const uint32 i = move_delta_index (c, k, from, to);
+    const bitboard mask = masks_0[from] | masks_0[to];
+
+    color_to_board (c) ^= mask;
+    kind_to_board (k) ^= mask;
+
+    if (P == APPLY_FULL)
+      {
+        hash ^= zobrist_move_keys[i];
+        psquares[c][OPENING_PHASE] += psq_opening (psq_move_deltas[i]);
+        psquares[c][END_PHASE] += psq_end (psq_move_deltas[i]);
+      }
+
+    if (k == PAWN)
+      {
+        if (P == APPLY_FULL)
+          phash ^= zobrist_move_keys[i];
+        if (P != APPLY_PLACEMENT)
+          {
+            pawn_counts[c][idx_to_file (from)]--;
+            pawn_counts[c][idx_to_file (to)]++;
+          }
+      }
+
+    occupied     ^= mask;
+    occupied_45  ^= masks_45[from] | masks_45[to];
+    occupied_90  ^= masks_90[from] | masks_90[to];
+    occupied_135 ^= masks_135[from] | masks_135[to];
+  }
+
+  // Apply a move to this board under a policy. Return false if the
+  // move is illegal, which APPLY_PLACEMENT never tests.
+  template <Apply_Policy P = APPLY_FULL>
+  bool apply (const Move &m) {
+    Undo dummy;
+    return apply <P> (m, dummy);
+  }
+
+  template <Apply_Policy P = APPLY_FULL>
+  bool apply (const Move &m, Undo &u) {
+    const bool legal = apply_move <P> (m, u);
+
+    // The lighter policies leave the hash unchanged, so it can no
+    // longer identify the position the check state belongs to.
+    if (P != APPLY_FULL)
+      check_key = ~hash;
+    return legal;
+  }
+
+  template <Apply_Policy P>
+  bool apply_move (const Move &m, Undo &u);
+
   void unapply (const Move &m, const Undo &u);
 
+  // Recompute the hash keys, piece square scores and pawn file counts
+  // from the placement of the pieces, after replaying moves under a
+  // policy other than APPLY_FULL.
+  void resync ();
+
+  // Make and take back a null move, which only passes the move to the
+  // other side and clears the en passant target.
+  void apply_null (Undo &u);
+  void unapply_null (const Undo &u);
+
   ////////////
   // Boards //
   ////////////
@@ -664,4 +806,12 @@ inline bool operator!= (const Move &lhs, const Move &rhs) {
     (lhs.promote != rhs.promote);
 }
 
+inline bool
+Move_Vector :: contains (const Move &m) const {
+  for (int i = 0; i < count; i++)
+    if (move[i] == m)
+      return true;
+  return false;
+}
+
 #endif // _BOARD_
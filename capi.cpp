@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// capi.cpp                                                                   //
+//                                                                            //
+// Implementation of the C interface declared in libchesley.h. All mutable    //
+// state lives in the engine handle. The move generation tables are built     //
+// once, by whichever handle is created first, and are then shared read       //
+// only.                                                                      //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "chesley.hpp"
+#include "libchesley.h"
+
+using namespace std;
+
+struct chesley_engine {
+
+  chesley_engine (uint32 hash_entries) :
+    se (hash_entries), board (Board::startpos ()),
+    score (0), depth (0), nodes (0) {
+    se.session_poll = false;
+    se.post = false;
+  }
+
+  // Search state.
+  Search_Engine se;
+
+  // The current position and the positions played to reach it.
+  Board board;
+  Search_Engine::Rep_Table history;
+
+  // Results of the last search.
+  Board searched;
+  Move_Vector pv;
+  Score score;
+  int depth;
+  uint64 nodes;
+
+  string error;
+};
+
+static once_flag tables_once;
+
+chesley_engine *
+chesley_create (size_t hash_entries) {
+  call_once (tables_once, precompute_tables);
+
+  if (hash_entries == 0)
+    hash_entries = Search_Engine::TT_SIZE;
+
+  chesley_engine *e = new (nothrow) chesley_engine ((uint32) hash_entries);
+  if (e && (!e -> se.tt.table || !e -> se.ph.table))
+    {
+      delete e;
+      e = NULL;
+    }
+
+  return e;
+}
+
+void
+chesley_destroy (chesley_engine *e) {
+  delete e;
+}
+
+int
+chesley_set_position (chesley_engine *e, const char *fen, const char *moves) {
+  try
+    {
+      Board b = fen ? Board::from_fen (string (fen)) : Board::startpos ();
+      Search_Engine::Rep_Table history;
+
+      if (!b.is_valid ())
+        throw string ("illegal position");
+
+      string_vector tokens = tokenize (moves ? moves : "");
+      for (size_t i = 0; i < tokens.size (); i++)
+        {
+          Move m = b.legal_from_calg (tokens[i]);
+          if (m == NULL_MOVE)
+            throw "illegal move " + tokens[i];
+          b.apply (m);
+          history[b.hash]++;
+        }
+
+      e -> board = b;
+      e -> history = history;
+      return 0;
+    }
+  catch (string s)
+    {
+      e -> error = s;
+    }
+  catch (...)
+    {
+      e -> error = "internal error";
+    }
+
+  return -1;
+}
+
+int
+chesley_search (chesley_engine *e, int depth, long long nodes,
+                int movetime_ms) {
+  Search_Engine &se = e -> se;
+  const Board &b = e -> board;
+
+  e -> searched = b;
+  e -> pv.clear ();
+  e -> score = 0;
+  e -> depth = 0;
+  e -> nodes = 0;
+
+  // There is nothing to search if the game is over.
+  Search_Engine::Rep_Table::iterator rep = e -> history.find (b.hash);
+  if (b.child_count () == 0 || (rep != e -> history.end () && rep -> second >= 3))
+    {
+      e -> score = b.in_check (b.to_move ()) ? -MATE_VAL : 0;
+      se.stop = false;
+      return 0;
+    }
+
+  if (movetime_ms > 0)
+    {
+      se.set_fixed_time (movetime_ms);
+    }
+  else
+    {
+      se.controls.mode = UNLIMITED;
+      se.controls.fixed_time = -1;
+    }
+  se.set_fixed_depth (depth);
+  se.set_fixed_nodes (nodes);
+  se.rt = e -> history;
+
+  int status = -1;
+  try
+    {
+      e -> score = se.compute_pv (b, MAX_DEPTH, e -> pv);
+      e -> depth = se.stats.depth;
+      e -> nodes = se.node_count ();
+      status = 0;
+    }
+  catch (string s)
+    {
+      e -> error = s;
+    }
+  catch (...)
+    {
+      e -> error = "internal error";
+    }
+
+  // A stop is cleared only once the search has returned, so that one
+  // arriving just before the search started is not lost.
+  se.stop = false;
+
+  if (status != 0)
+    e -> pv.clear ();
+  return status;
+}
+
+void
+chesley_stop (chesley_engine *e) {
+  e -> se.stop = true;
+}
+
+int
+chesley_get_score (const chesley_engine *e) {
+  return e -> score;
+}
+
+int
+chesley_get_depth (const chesley_engine *e) {
+  return e -> depth;
+}
+
+long long
+chesley_get_nodes (const chesley_engine *e) {
+  return e -> nodes;
+}
+
+size_t
+chesley_get_pv (const chesley_engine *e, char *buf, size_t len) {
+  string s;
+  for (int i = 0; i < e -> pv.count; i++)
+    s += (i > 0 ? " " : "") + e -> searched.to_calg (e -> pv[i]);
+
+  if (buf && len > 0)
+    {
+      size_t n = min (s.length (), len - 1);
+      memcpy (buf, s.data (), n);
+      buf[n] = '\0';
+    }
+
+  return s.length ();
+}
+
+const char *
+chesley_last_error (const chesley_engine *e) {
+  return e -> error.c_str ();
+}
@@ -15,14 +15,21 @@
 
 #include <cstdio>
 
+#include "batch.hpp"
 #include "bits64.hpp"
 #include "board.hpp"
+#include "cluster.hpp"
 #include "common.hpp"
 #include "eval.hpp"
+#include "mate.hpp"
 #include "move.hpp"
+#include "numa.hpp"
 #include "pgn.hpp"
+#include "pgnfilter.hpp"
 #include "phash.hpp"
+#include "scheduler.hpp"
 #include "search.hpp"
+#include "server.hpp"
 #include "session.hpp"
 #include "stats.hpp"
 #include "ttable.hpp"
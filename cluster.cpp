@@ -0,0 +1,579 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// cluster.cpp                                                                //
+//                                                                            //
+// Distributed analysis of a single position. A coordinator process runs      //
+// iterative deepening, splitting the root moves between worker processes     //
+// at each iteration. Each worker searches the position with every move       //
+// but its own excluded, so the best of their results is the value of the     //
+// position. Workers keep their transposition tables between iterations and   //
+// report the entries they store for deep searches, which the coordinator     //
+// forwards to every other worker in a batch ahead of its next search.        //
+//                                                                            //
+// The protocol is line oriented. The coordinator sends                       //
+//                                                                            //
+//   tt <key> <move> <score> <depth> <kind> <eval>                            //
+//   search depth <d> share <s> moves <calg> ... fen <fen>                    //
+//   quit                                                                     //
+//                                                                            //
+// and a worker answers each search with any number of "tt" lines followed    //
+// by one line,                                                               //
+//                                                                            //
+//   move <calg> score <cp> depth <ply> nodes <n> pv <calg> ...               //
+//                                                                            //
+// or "error <message>".                                                      //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "chesley.hpp"
+
+using namespace std;
+
+// The most transposition table entries a worker reports per search.
+static const size_t MAX_SHARED = 4096;
+
+// The most entries queued for a worker between searches.
+static const size_t MAX_PENDING = 4 * MAX_SHARED;
+
+////////////////
+// Networking //
+////////////////
+
+// Open a socket listening on, or connected to, an address. An address
+// containing a '/' names a Unix domain socket, otherwise it is a TCP
+// port optionally preceded by "host:". Returns -1 on failure.
+static int
+open_socket (const string &addr, bool listening) {
+  int fd;
+
+  if (addr.find ('/') != string::npos)
+    {
+      struct sockaddr_un sa;
+      memset (&sa, 0, sizeof (sa));
+      if (addr.length () >= sizeof (sa.sun_path))
+        return -1;
+      sa.sun_family = AF_UNIX;
+      strcpy (sa.sun_path, addr.c_str ());
+
+      if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+
+      if (listening)
+        {
+          unlink (addr.c_str ());
+          if (bind (fd, (struct sockaddr *) &sa, sizeof (sa)) < 0 ||
+              listen (fd, 64) < 0)
+            {
+              close (fd);
+              return -1;
+            }
+        }
+      else if (connect (fd, (struct sockaddr *) &sa, sizeof (sa)) < 0)
+        {
+          close (fd);
+          return -1;
+        }
+
+      return fd;
+    }
+
+  // Split a TCP address into host and port.
+  size_t colon = addr.rfind (':');
+  string host = colon == string::npos ? "" : addr.substr (0, colon);
+  string port = colon == string::npos ? addr : addr.substr (colon + 1);
+
+  struct addrinfo hints, *res;
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = listening ? AI_PASSIVE : 0;
+
+  if (!listening && host.empty ())
+    host = "127.0.0.1";
+
+  if (getaddrinfo (host.empty () ? NULL : host.c_str (), port.c_str (),
+                   &hints, &res) != 0)
+    return -1;
+
+  fd = -1;
+  for (struct addrinfo *ai = res; ai && fd < 0; ai = ai -> ai_next)
+    {
+      if ((fd = socket (ai -> ai_family, ai -> ai_socktype,
+                        ai -> ai_protocol)) < 0)
+        continue;
+
+      int one = 1;
+      bool ok;
+      if (listening)
+        {
+          setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+          ok = bind (fd, ai -> ai_addr, ai -> ai_addrlen) == 0 &&
+            listen (fd, 64) == 0;
+        }
+      else
+        {
+          ok = connect (fd, ai -> ai_addr, ai -> ai_addrlen) == 0;
+          setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+        }
+
+      if (!ok)
+        {
+          close (fd);
+          fd = -1;
+        }
+    }
+
+  freeaddrinfo (res);
+  return fd;
+}
+
+// Format a transposition table entry as a "tt" line.
+static string
+format_entry (const TTable::Entry &e) {
+  uint32 move;
+  memcpy (&move, &e.move, sizeof (move));
+
+  char buf[128];
+  snprintf (buf, sizeof (buf), "tt %llx %u %i %i %i %i\n",
+            (unsigned long long) e.key, move, (int) e.score,
+            (int) e.depth, (int) e.skind, (int) e.eval);
+  return buf;
+}
+
+// Parse a "tt" line, returning false if it is malformed.
+static bool
+parse_entry (const string_vector &tokens, TTable::Entry &e) {
+  if (tokens.size () != 7)
+    return false;
+
+  uint32 move = strtoul (tokens[2].c_str (), NULL, 10);
+  int skind = to_int (tokens[5]);
+  if (skind < LOWER_BOUND || skind > EXACT_VALUE)
+    return false;
+
+  e.key = strtoull (tokens[1].c_str (), NULL, 16);
+  memcpy ((void *) &e.move, &move, sizeof (move));
+  e.score = to_int (tokens[3]);
+  e.depth = to_int (tokens[4]);
+  e.skind = (SKind) skind;
+  e.eval = to_int (tokens[6]);
+  return true;
+}
+
+////////////
+// Worker //
+////////////
+
+// Search a position with every root move not listed excluded, then
+// report the deepest entries stored and the result.
+static void
+worker_search (Search_Engine &se, vector <TTable::Entry> &exported,
+               const string_vector &tokens, FILE *out) {
+  int depth = 1;
+  string_vector moves, fen;
+
+  for (size_t i = 1; i < tokens.size (); i++)
+    {
+      if (tokens[i] == "depth" && i + 1 < tokens.size ())
+        depth = to_int (tokens[++i]);
+      else if (tokens[i] == "share" && i + 1 < tokens.size ())
+        se.tt_export_depth = to_int (tokens[++i]);
+      else if (tokens[i] == "moves")
+        while (i + 1 < tokens.size () && tokens[i + 1] != "fen")
+          moves.push_back (tokens[++i]);
+      else if (tokens[i] == "fen")
+        while (i + 1 < tokens.size ())
+          fen.push_back (tokens[++i]);
+    }
+
+  Board b;
+  Move_Vector pv;
+  Score score;
+
+  try
+    {
+      b = Board::from_fen (fen);
+    }
+  catch (string e)
+    {
+      fprintf (out, "error %s\n", e.c_str ());
+      return;
+    }
+
+  // Exclude every legal move which is not ours.
+  Move_Vector all (b);
+  size_t ours = 0;
+  se.excluded.clear ();
+  for (int i = 0; i < all.count; i++)
+    {
+      Board c = b;
+      if (!c.apply (all[i]))
+        continue;
+      if (find (moves.begin (), moves.end (), b.to_calg (all[i])) ==
+          moves.end ())
+        se.excluded.push (all[i]);
+      else
+        ours++;
+    }
+
+  if (ours == 0 || ours != moves.size ())
+    {
+      se.excluded.clear ();
+      fprintf (out, "error illegal root move\n");
+      return;
+    }
+
+  se.controls.mode = UNLIMITED;
+  se.controls.fixed_time = -1;
+  se.set_fixed_depth (depth);
+  se.set_fixed_nodes (-1);
+  se.rt.clear ();
+  exported.assign (MAX_SHARED, TTable::Entry ());
+
+  try
+    {
+      score = se.compute_pv (b, MAX_DEPTH, pv);
+    }
+  catch (string e)
+    {
+      se.excluded.clear ();
+      fprintf (out, "error %s\n", e.c_str ());
+      return;
+    }
+
+  se.excluded.clear ();
+
+  // Report the slots filled by the search, deepest first.
+  vector <TTable::Entry> entries;
+  for (int d = MAX_DEPTH; d >= se.tt_export_depth; d--)
+    for (size_t i = 0; i < exported.size (); i++)
+      if (exported[i].key != 0 && exported[i].depth == d)
+        entries.push_back (exported[i]);
+
+  for (size_t i = 0; i < entries.size (); i++)
+    fputs (format_entry (entries[i]).c_str (), out);
+
+  fprintf (out, "%s\n", se.summary (b, score, pv).c_str ());
+}
+
+// Connect to a coordinator and serve its requests until it quits.
+static int
+worker_main (const string &addr) {
+  int fd = open_socket (addr, false);
+  if (fd < 0)
+    {
+      perror (addr.c_str ());
+      return 1;
+    }
+
+  FILE *in = fdopen (fd, "r");
+  FILE *out = fdopen (dup (fd), "w");
+
+  Search_Engine *se = new Search_Engine ();
+  vector <TTable::Entry> exported;
+  se -> session_poll = false;
+  se -> post = false;
+  se -> tt_export = &exported;
+
+  while (char *line = get_line (in))
+    {
+      string_vector tokens = tokenize (line);
+      free (line);
+      if (tokens.size () == 0)
+        continue;
+
+      TTable::Entry e = TTable::Entry ();
+      if (tokens[0] == "tt" && parse_entry (tokens, e))
+        {
+          se -> tt.import (e);
+        }
+      else if (tokens[0] == "search")
+        {
+          worker_search (*se, exported, tokens, out);
+          fflush (out);
+        }
+      else if (tokens[0] == "quit")
+        {
+          break;
+        }
+    }
+
+  delete se;
+  fclose (in);
+  fclose (out);
+  return 0;
+}
+
+/////////////////
+// Coordinator //
+/////////////////
+
+// A connection to a worker.
+struct Worker_Link {
+  FILE *in;
+  FILE *out;
+  vector <string> pending; // Entries to send ahead of the next search.
+};
+
+// Accept workers and analyze a position to a fixed depth.
+static int
+coordinator_main (const string &addr, int nworkers, int depth,
+                  const string &fen, int share_depth, bool spawn) {
+  Board b;
+  try
+    {
+      b = fen.empty () ? Board::startpos () : Board::from_fen (fen);
+    }
+  catch (string e)
+    {
+      fprintf (stderr, "%s\n", e.c_str ());
+      return 1;
+    }
+
+  // Collect the legal root moves.
+  Move_Vector all (b), root;
+  for (int i = 0; i < all.count; i++)
+    {
+      Board c = b;
+      if (c.apply (all[i]))
+        root.push (all[i]);
+    }
+
+  if (root.count == 0)
+    {
+      fprintf (stderr, "no legal moves\n");
+      return 1;
+    }
+
+  int listen_fd = open_socket (addr, true);
+  if (listen_fd < 0)
+    {
+      perror (addr.c_str ());
+      return 1;
+    }
+
+  // Start local workers if asked to.
+  vector <pid_t> children;
+  if (spawn)
+    {
+      string connect_addr = addr.find_first_of ("/:") == string::npos ?
+        "127.0.0.1:" + addr : addr;
+      for (int i = 0; i < nworkers; i++)
+        {
+          pid_t pid = fork ();
+          if (pid == 0)
+            {
+              close (listen_fd);
+              execl (arg0, arg0, "cluster", "worker", "--connect",
+                     connect_addr.c_str (), (char *) NULL);
+              _exit (1);
+            }
+          if (pid > 0)
+            children.push_back (pid);
+        }
+    }
+
+  fprintf (stderr, "waiting for %i workers on %s\n", nworkers, addr.c_str ());
+
+  vector <Worker_Link> workers (nworkers);
+  for (int i = 0; i < nworkers; i++)
+    {
+      int fd = accept (listen_fd, NULL, NULL);
+      if (fd < 0)
+        {
+          if (errno == EINTR) { i--; continue; }
+          perror ("accept");
+          return 1;
+        }
+      workers[i].in = fdopen (fd, "r");
+      workers[i].out = fdopen (dup (fd), "w");
+    }
+  close (listen_fd);
+  if (addr.find ('/') != string::npos)
+    unlink (addr.c_str ());
+
+  string fen_str = b.to_fen ();
+  string best;
+  uint64 total_nodes = 0, shared = 0;
+  uint64 start = mclock ();
+  bool failed = false;
+
+  for (int d = 1; d <= depth && !failed; d++)
+    {
+      // Hand out root moves round robin, so that each worker keeps
+      // the same moves from one iteration to the next.
+      vector <bool> busy (nworkers, false);
+      for (int w = 0; w < nworkers; w++)
+        {
+          string moves;
+          for (int i = w; i < root.count; i += nworkers)
+            moves += " " + b.to_calg (root[i]);
+          if (moves.empty ())
+            continue;
+
+          for (size_t i = 0; i < workers[w].pending.size (); i++)
+            fputs (workers[w].pending[i].c_str (), workers[w].out);
+          workers[w].pending.clear ();
+
+          fprintf (workers[w].out, "search depth %i share %i moves%s fen %s\n",
+                   d, share_depth, moves.c_str (), fen_str.c_str ());
+          fflush (workers[w].out);
+          busy[w] = true;
+        }
+
+      // Gather results, queuing each reported entry for every other
+      // worker.
+      Score best_score = -INF;
+      for (int w = 0; w < nworkers; w++)
+        {
+          if (!busy[w])
+            continue;
+
+          char *line;
+          while ((line = get_line (workers[w].in)))
+            {
+              string s = line;
+              free (line);
+
+              if (s.compare (0, 3, "tt ") == 0)
+                {
+                  shared++;
+                  for (int j = 0; j < nworkers; j++)
+                    if (j != w && workers[j].pending.size () < MAX_PENDING)
+                      workers[j].pending.push_back (s + "\n");
+                  continue;
+                }
+
+              string_vector tokens = tokenize (s);
+              if (tokens.size () >= 8 && tokens[0] == "move")
+                {
+                  total_nodes += atoll (tokens[7].c_str ());
+                  Score score = to_int (tokens[3]);
+                  if (score > best_score)
+                    {
+                      best_score = score;
+                      best = s;
+                    }
+                }
+              else
+                {
+                  fprintf (stderr, "worker %i: %s\n", w, s.c_str ());
+                  failed = true;
+                }
+              break;
+            }
+
+          if (!line)
+            {
+              fprintf (stderr, "worker %i disconnected\n", w);
+              failed = true;
+            }
+        }
+
+      if (!failed)
+        {
+          string_vector tokens = tokenize (best);
+          printf ("depth %i score %i nodes %llu time %.2f shared %llu pv",
+                  d, best_score, (unsigned long long) total_nodes,
+                  (mclock () - start) / 1000.0, (unsigned long long) shared);
+          for (size_t i = 9; i < tokens.size (); i++)
+            printf (" %s", tokens[i].c_str ());
+          printf ("\n");
+          fflush (stdout);
+        }
+    }
+
+  for (int w = 0; w < nworkers; w++)
+    {
+      fprintf (workers[w].out, "quit\n");
+      fclose (workers[w].out);
+      fclose (workers[w].in);
+    }
+
+  for (size_t i = 0; i < children.size (); i++)
+    waitpid (children[i], NULL, 0);
+
+  if (failed)
+    return 1;
+
+  // Write the final result in the same form as a worker's, with the
+  // total nodes searched by every worker.
+  string_vector tokens = tokenize (best);
+  printf ("move %s score %s depth %i nodes %llu pv",
+          tokens[1].c_str (), tokens[3].c_str (), depth,
+          (unsigned long long) total_nodes);
+  for (size_t i = 9; i < tokens.size (); i++)
+    printf (" %s", tokens[i].c_str ());
+  printf ("\n");
+
+  return 0;
+}
+
+// Entry point for "chesley cluster".
+int
+cluster_main (int argc, char **argv) {
+  string mode = argc > 1 ? argv[1] : "";
+  string addr, fen;
+  int workers = 2, depth = 8, share_depth = 4;
+  bool spawn = false, ok = mode == "coordinator" || mode == "worker";
+
+  for (int i = 2; ok && i < argc; i++)
+    {
+      string arg = argv[i];
+      if ((arg == "--listen" || arg == "--connect") && i + 1 < argc)
+        addr = argv[++i];
+      else if (arg == "--workers" && i + 1 < argc)
+        workers = atoi (argv[++i]);
+      else if (arg == "--depth" && i + 1 < argc)
+        depth = atoi (argv[++i]);
+      else if (arg == "--fen" && i + 1 < argc)
+        fen = argv[++i];
+      else if (arg == "--share-depth" && i + 1 < argc)
+        share_depth = atoi (argv[++i]);
+      else if (arg == "--spawn")
+        spawn = true;
+      else
+        ok = false;
+    }
+
+  if (!ok || addr.empty () || workers < 1 || depth < 1)
+    {
+      fprintf (stderr,
+               "usage: %s cluster coordinator --listen ADDR [--workers N] "
+               "[--depth D]\n"
+               "                   [--fen FEN] [--share-depth S] [--spawn]\n"
+               "       %s cluster worker --connect ADDR\n", arg0, arg0);
+      return 1;
+    }
+
+  // A worker which has gone away should not kill the coordinator.
+  signal (SIGPIPE, SIG_IGN);
+
+  if (mode == "worker")
+    return worker_main (addr);
+
+  return coordinator_main (addr, workers, min (depth, MAX_DEPTH - 1),
+                           fen, share_depth, spawn);
+}
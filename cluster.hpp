@@ -0,0 +1,31 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// cluster.hpp                                                                //
+//                                                                            //
+// Distributed analysis of a single position by several engine processes,     //
+// possibly on different machines, connected over TCP or Unix sockets.        //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CLUSTER_
+#define _CLUSTER_
+
+// Entry point for "chesley cluster". A coordinator is started with
+//
+//   chesley cluster coordinator --listen ADDR --workers N --depth D
+//                   [--fen FEN] [--share-depth S] [--spawn]
+//
+// and each worker with
+//
+//   chesley cluster worker --connect ADDR
+//
+// where ADDR is a port or host:port for TCP, or a path containing a
+// '/' for a Unix domain socket. With --spawn the coordinator starts
+// its N workers itself on the local machine.
+int cluster_main (int argc, char **argv);
+
+#endif // _CLUSTER_
@@ -40,9 +40,11 @@ enum Command
     // User commands //
     ///////////////////
 
+    CMD_ANNOTATE,
     CMD_BLACK,
     CMD_DISP,
     CMD_DTC,
+    CMD_EPDANALYZE,
     CMD_EVAL,
     CMD_FEN,
     CMD_FORCE,
@@ -50,14 +52,18 @@ enum Command
     CMD_HELP,
     CMD_INTERRUPT,
     CMD_LEVEL,
+    CMD_MATE,
     CMD_MOVE,
     CMD_MOVES,
     CMD_NEW,
+    CMD_NUMA,
     CMD_PLAYOTHER,
     CMD_PLAYSELF,
+    CMD_PUZZLES,
     CMD_QUIT,
     CMD_SD,
     CMD_SETBOARD,
+    CMD_SHM,
     CMD_ST,
     CMD_TIME,
     CMD_WHITE,
@@ -67,14 +73,17 @@ enum Command
     ////////////////////////
 
     CMD_APPLY,
+    CMD_APPLYBENCH,
     CMD_ATTACKS,
     CMD_BENCH,
     CMD_DIV,
     CMD_DUMPPAWNS,
     CMD_DUMPPGN,
     CMD_EPD,
+    CMD_FENBENCH,
     CMD_HASH,
     CMD_PERFT,
+    CMD_REPLAYTEST,
     CMD_TESTHASHING,
 
     ///////////////////////////
@@ -132,6 +141,9 @@ static const struct {
   // User commands //
   ///////////////////
 
+  { CMD_ANNOTATE, USER_CMD,   "ANNOTATE",  "<pgn> [out <file>] [depth <d>]",
+    "Annotate the games in a PGN file." },
+
   { CMD_BLACK, USER_CMD,      "BLACK",     "",
     "Set user to play black." },
 
@@ -141,6 +153,9 @@ static const struct {
   { CMD_DTC,   USER_CMD,      "DTC" ,      "",
     "Print time control settings." },
 
+  { CMD_EPDANALYZE, USER_CMD, "EPDANALYZE", "<epd> [out <file>] [depth <d>]",
+    "Analyze an EPD file, writing acd, acn, acs, ce, pm and pv." },
+
   { CMD_EVAL,  USER_CMD,      "EVAL",      "",
     "Print the static evaluation for this position."},
 
@@ -162,6 +177,9 @@ static const struct {
   { CMD_LEVEL, USER_CMD,      "LEVEL",     "<moves time increment>",
     "Set time controls"},
 
+  { CMD_MATE,  USER_CMD,      "MATE",      "<n> [nodes <count>]",
+    "Search for a mate by checks in at most n moves."},
+
   { CMD_MOVE,  USER_CMD,      "MOVE",      "<move>",
     "Make a move." },
 
@@ -171,12 +189,18 @@ static const struct {
   { CMD_NEW,   USER_CMD,      "NEW",       "",
     "Start a new game." },
 
+  { CMD_NUMA,  USER_CMD,      "NUMA",      "[<policy>] [<pin>]",
+    "Set NUMA table placement and thread pinning for workers." },
+
   { CMD_PLAYOTHER, USER_CMD,  "PLAYOTHER", "",
     "Swap the sides played by the engine and the user." },
 
   { CMD_PLAYSELF, USER_CMD,   "PLAYSELF",  "",
     "Display play a computer vs. computer games."},
 
+  { CMD_PUZZLES, USER_CMD,    "PUZZLES",   "<pgn> [out <file>] [depth <d>]",
+    "Mine tactical puzzles from a PGN file, writing EPD." },
+
   { CMD_QUIT,  USER_CMD,      "QUIT",      "",
     "Quit Chesley." },
 
@@ -186,6 +210,10 @@ static const struct {
   { CMD_SETBOARD, USER_CMD,   "SETBOARD",  "<fen>",
     "Set the board from a FEN string."},
 
+  { CMD_SHM,   USER_CMD,      "SHM",
+    "[<name> [<megabytes>] | off | unlink <name>]",
+    "Share the transposition table with other processes."},
+
   { CMD_ST,    USER_CMD,      "ST",        "<time>",
     "Set a fixed time per move"},
 
@@ -202,6 +230,9 @@ static const struct {
   { CMD_APPLY,      DEBUG_CMD,     "APPLY",     "",
     "Apply a move." },
 
+  { CMD_APPLYBENCH, DEBUG_CMD,     "APPLYBENCH", "<count>",
+    "Time move application."},
+
   { CMD_ATTACKS,    DEBUG_CMD,     "ATTACKS",   "",
     "Display a map of attacked squares." },
 
@@ -222,12 +253,18 @@ static const struct {
   { CMD_EPD,        DEBUG_CMD,     "EPD",       "<epd>",
     "Evaluate an EPD string."},
 
+  { CMD_FENBENCH,   DEBUG_CMD,     "FENBENCH",  "<count>",
+    "Time FEN parsing."},
+
   { CMD_HASH,       DEBUG_CMD,     "HASH",      "",
     "Print the current position hash."},
 
   { CMD_PERFT,      DEBUG_CMD,     "PERFT",     "<depth>",
     "Compute perft to a fixed depth."},
 
+  { CMD_REPLAYTEST, DEBUG_CMD,     "REPLAYTEST", "<file> [<passes>]",
+    "Replay a PGN file under each move application policy."},
+
   { CMD_TESTHASHING,DEBUG_CMD, "TESTHASHING", "",
     "Run a test on hash code generation."},
 
@@ -328,13 +365,12 @@ static const struct {
 };
 
 // Return a command code from a given string.
-static Command match_command (string s);
-static Command match_command (string s) {
-  s = upcase (s);
+static Command match_command (String_View s);
+static Command match_command (String_View s) {
   for (int i = 0; i < CMD_COUNT; i++)
     {
       assert (commands[i].code == i);
-      if (s == commands[i].str)
+      if (s.equals (commands[i].str, true))
         {
           return commands[i].code;
         }
@@ -345,22 +381,30 @@ static Command match_command (string s) {
 bool
 Session::execute (char *line) {
 
-  string_vector tokens = tokenize (line);
+  // The command is matched in place. Arguments are read from the rest
+  // of the line, or the line is tokenized by commands not yet
+  // converted, which are none of those sent during a game.
+  String_View args (line);
+  String_View token = next_token (args);
 
-  if (tokens.size () == 0) return true;
+  if (token.empty ()) return true;
 
-  string token = tokens[0];
   Command cmd = match_command (token);
   switch (cmd)
     {
     case CMD_NULL:
-      fprintf (out, "Unrecognized command: %s\n", token.c_str ());
+      fprintf (out, "Unrecognized command: %s\n", token.str ().c_str ());
       break;
 
     ///////////////////
     // User commands //
     ///////////////////
 
+    case CMD_ANNOTATE:
+      // Annotate the games in a PGN file.
+      annotate (tokenize (line));
+      break;
+
     case CMD_BLACK:
       // Set user to play black.
       board.set_color (BLACK);
@@ -374,12 +418,17 @@ Session::execute (char *line) {
 
     case CMD_DTC:
       // Display the current time controls.
-      display_time_controls (rest (tokens));
+      display_time_controls (rest (tokenize (line)));
+      break;
+
+    case CMD_EPDANALYZE:
+      // Analyze the positions in an EPD file.
+      epd_analyze (tokenize (line));
       break;
 
     case CMD_EVAL:
       // Output the static evaluation for this position.
-      fprintf (out, "%i\n", Eval (board).score ());
+      fprintf (out, "%i\n", Eval (board, se.ph).score ());
       break;
 
     case CMD_FEN:
@@ -400,7 +449,7 @@ Session::execute (char *line) {
 
     case CMD_HELP:
       // Print help message for the user.
-      display_help (rest (tokens));
+      display_help (rest (tokenize (line)));
       break;
 
     case CMD_INTERRUPT:
@@ -409,14 +458,19 @@ Session::execute (char *line) {
       break;
 
     case CMD_LEVEL:
-      level (rest (tokens));
+      level (rest (tokenize (line)));
+      break;
+
+    case CMD_MATE:
+      // Search for a mate with the proof-number solver.
+      mate (tokenize (line));
       break;
 
     case CMD_USERMOVE:
     case CMD_MOVE:
       // Play a move.
       {
-        Move m = board.from_calg (tokens[1]);
+        Move m = board.from_calg (next_token (args).str ());
         bool applied = board.apply (m);
         se.rt_push (board);
 
@@ -451,6 +505,23 @@ Session::execute (char *line) {
       running = true;
       break;
 
+    case CMD_NUMA:
+      // Set the placement of tables and threads for engines created
+      // from now on, such as the workers of EPDANALYZE.
+      for (String_View t = next_token (args); !t.empty ();
+           t = next_token (args))
+        {
+          string arg = t.str ();
+          downcase (arg);
+          if (!parse_numa_policy (arg, numa_policy) &&
+              !parse_numa_pin (arg, numa_pin))
+            fprintf (out, "Error: unknown NUMA setting %s\n",
+                     t.str ().c_str ());
+        }
+      fprintf (out, "%i node(s), policy %i, pinning %i\n",
+               numa_node_count (), (int) numa_policy, (int) numa_pin);
+      break;
+
     case CMD_PLAYOTHER:
       // Swap colors between the engine and the user.
       our_color = invert (our_color);
@@ -458,7 +529,12 @@ Session::execute (char *line) {
 
     case CMD_PLAYSELF:
       // Play an engine vs. engine game on the console.
-      play_self (tokens);
+      play_self (tokenize (line));
+      break;
+
+    case CMD_PUZZLES:
+      // Mine tactical puzzles from a PGN file.
+      puzzles (tokenize (line));
       break;
 
     case CMD_QUIT:
@@ -467,22 +543,79 @@ Session::execute (char *line) {
 
     case CMD_SD:
       // Set fixed depth search mode.
-      se.set_fixed_depth (to_int (tokens[1]));
+      se.set_fixed_depth (to_int (next_token (args).str ()));
       break;
 
     case CMD_SETBOARD:
       // Set the board from a fen string.
-      board = Board::from_fen (rest (tokens), false);
+      try
+        {
+          board = Board::from_fen (args, false);
+        }
+      catch (string e)
+        {
+          fprintf (out, "Error: %s\n", e.c_str ());
+        }
+      break;
+
+    case CMD_SHM:
+      // Attach the transposition table to a shared memory segment,
+      // detach it, remove a segment or report on it. A segment lasts
+      // until it is removed, even once no process is using it.
+      {
+        // Either <name> [<megabytes>], off or unlink <name>.
+        String_View first = next_token (args);
+        String_View second = next_token (args);
+
+        if (first.empty ())
+          {
+            if (se.tt.is_shared ())
+              fprintf (out, "shared table of %llu entries, "
+                       "%llu of %llu hits from other processes\n",
+                       (unsigned long long) se.tt.sz,
+                       (unsigned long long) se.tt.shared_hits,
+                       (unsigned long long) se.tt.hits);
+            else
+              fprintf (out, "private table of %llu entries\n",
+                       (unsigned long long) se.tt.sz);
+          }
+        else if (first.equals ("off", true))
+          {
+            se.tt.detach ();
+          }
+        else if (first.equals ("unlink", true))
+          {
+            if (second.empty () ||
+                !TTable::unlink (second.str ().c_str ()))
+              fprintf (out, "Error: no shared table %s\n",
+                       second.str ().c_str ());
+          }
+        else
+          {
+            size_t entries = se.tt.sz;
+            if (!second.empty ())
+              entries = ((size_t) to_int (second.str ()) << 20)
+                / sizeof (TTable::Entry);
+            try
+              {
+                se.tt.attach (first.str ().c_str (), entries);
+              }
+            catch (string e)
+              {
+                fprintf (out, "Error: %s\n", e.c_str ());
+              }
+          }
+      }
       break;
 
     case CMD_ST:
       // Set fixed time move mode.
-      se.set_fixed_time (1000 * to_int (tokens[1]));
+      se.set_fixed_time (1000 * to_int (next_token (args).str ()));
       break;
 
     case CMD_TIME:
       // Set the clock.
-      se.set_time_remaining (10 * to_int (tokens[1]));
+      se.set_time_remaining (10 * to_int (next_token (args).str ()));
       break;
 
     case CMD_WHITE:
@@ -500,15 +633,16 @@ Session::execute (char *line) {
       // Apply list of moves to the current position.
 
       running = false;
-      for (uint32 i = 1; i < tokens.size (); i++)
+      for (String_View t = next_token (args); !t.empty ();
+           t = next_token (args))
         {
-          Move m = board.from_san (tokens[i]);
+          Move m = board.from_san (t.str ());
           cerr << m << endl;
           board.apply (m);
         }
 
       break;
-      board.apply (board.from_calg (tokens[1]));
+      board.apply (board.from_calg (next_token (args).str ()));
       break;
 
     case CMD_ATTACKS:
@@ -518,17 +652,17 @@ Session::execute (char *line) {
 
     case CMD_BENCH:
       // Search the current position to a fixed depth.
-      bench (tokens);
+      bench (tokenize (line));
       break;
 
     case CMD_DIV:
       // Output the perft score for each child.
-      board.divide (to_int (tokens[1]));
+      board.divide (to_int (next_token (args).str ()));
       break;
 
     case CMD_DUMPPAWNS:
       // Dump pawn structure to a file.
-      dump_pawns (tokens);
+      dump_pawns (tokenize (line));
       break;
 
     case CMD_DUMPPGN:
@@ -558,13 +692,23 @@ Session::execute (char *line) {
 
     case CMD_EPD:
       // Execute an epd string.
-      epd (tokens);
+      epd (args);
+      break;
+
+    case CMD_FENBENCH:
+      // Time FEN parsing.
+      fen_bench (tokenize (line));
+      break;
+
+    case CMD_APPLYBENCH:
+      // Time move application.
+      apply_bench (tokenize (line));
       break;
 
     case CMD_PERFT:
       // Compute perft to a fixed depth.
       {
-        int depth = (to_int (tokens[1]));
+        int depth = (to_int (next_token (args).str ()));
         for (int i = 1; i <= depth; i++)
           {
             uint64 start = cpu_time();
@@ -581,6 +725,11 @@ Session::execute (char *line) {
       cout << board.hash << endl;
       break;
 
+    case CMD_REPLAYTEST:
+      // Check and time replaying games under each apply policy.
+      replay_test (tokenize (line));
+      break;
+
     case CMD_TESTHASHING:
       // Check that incrementally update hash codes are identical to
       // codes generated from scratch to depth 5.
@@ -593,14 +742,20 @@ Session::execute (char *line) {
 
     case CMD_GENMSTATS:
       // Generate statistics about material balance.
-      if (tokens.size () >= 2)
-        gen_material_stats (tokens[1]);
+      {
+        String_View file = next_token (args);
+        if (!file.empty ())
+          gen_material_stats (file.str ());
+      }
       break;
 
     case CMD_GENPSQ:
       // Generate piece square tables from a .pgn file.
-      if (tokens.size () >= 2)
-        gen_psq_tables (tokens[1]);
+      {
+        String_View file = next_token (args);
+        if (!file.empty ())
+          gen_psq_tables (file.str ());
+      }
       break;
 
     /////////////////////
@@ -629,7 +784,7 @@ Session::execute (char *line) {
       break;
 
     case CMD_EASY:
-      Session::ponder_enabled = false;
+      se.ponder_enabled = false;
       break;
 
     case CMD_EDIT:
@@ -637,7 +792,7 @@ Session::execute (char *line) {
       break;
 
     case CMD_HARD:
-      Session::ponder_enabled = true;
+      se.ponder_enabled = true;
       break;
 
     case CMD_HINT:
@@ -665,7 +820,10 @@ Session::execute (char *line) {
       break;
 
     case CMD_PING:
-      fprintf (out, "pong %s\n", tokens[1].c_str ());
+      {
+        String_View n = next_token (args);
+        fprintf (out, "pong %.*s\n", (int) n.size (), n.begin ());
+      }
       break;
 
     case CMD_POST:
@@ -729,7 +887,7 @@ Session::execute (char *line) {
     case CMD_XBOARD:
       // Set Xboard mode.
       xboard = true;
-      return set_xboard_mode (tokens);
+      return set_xboard_mode (tokenize (line));
       break;
 
     default:
@@ -174,6 +174,9 @@ inline int      idx_to_rank           (Coord idx);
 inline int      idx_to_file           (Coord idx);
 inline Coord    to_idx                (int rank, int file);
 inline hash_t   get_zobrist_piece_key (Color c, Kind k, Coord idx);
+inline uint32   move_delta_index      (Color c, Kind k, Coord from, Coord to);
+inline Score    psq_opening           (int32 packed);
+inline Score    psq_end               (int32 packed);
 
 // Test whether a coordinate is in bounds.
 inline bool
@@ -240,6 +243,7 @@ dist (Coord a, Coord b) {
 }
 
 extern uint64 *zobrist_piece_keys;
+extern uint64 *zobrist_move_keys;
 extern uint64 *zobrist_enpassant_keys;
 extern uint64  zobrist_key_white_to_move;
 extern uint64  zobrist_w_castle_q_key;
@@ -259,6 +263,31 @@ get_zobrist_piece_key (Color c, Kind k, Coord idx) {
   return zobrist_piece_keys[i * (64 * 6) + j * (64) + idx];
 }
 
+// Changes to the hash key and piece square scores made by moving a
+// piece are tabulated by color, kind, origin and destination. The
+// opening and end game scores are packed into one word, the opening
+// score in the high half.
+extern int32 *psq_move_deltas;
+
+// Index the move delta tables.
+inline uint32
+move_delta_index (Color c, Kind k, Coord from, Coord to) {
+  uint32 i = (c == BLACK ? 0 : 1);
+  return ((i * 6 + (uint32) k) * 64 + from) * 64 + to;
+}
+
+// Unpack the opening score from a packed pair.
+inline Score
+psq_opening (int32 packed) {
+  return (int16) ((uint32) (packed + 0x8000) >> 16);
+}
+
+// Unpack the end game score from a packed pair.
+inline Score
+psq_end (int32 packed) {
+  return (int16) (packed & 0xFFFF);
+}
+
 //////////////////////////////////////
 // Precomputed tables and constants //
 //////////////////////////////////////
@@ -329,6 +358,26 @@ extern bitboard *pawn_attack_spans[2];
 extern bitboard *in_front_of[2];
 extern bitboard *adjacent_files;
 
+// Squares strictly between two squares on a rank, file or diagonal,
+// indexed by [from * 64 + to]. Empty if they share no line.
+extern bitboard *between;
+
+// Cuckoo tables of the keys of every reversible piece move, that is
+// the change in hash a move of a piece other than a pawn makes on an
+// empty board. Each key is stored at one of two hashed locations,
+// with the squares of its move stored as from | to << 6.
+const int CUCKOO_SIZE = 8192;
+extern hash_t *cuckoo_keys;
+extern uint16 *cuckoo_moves;
+
+inline uint32 cuckoo_h1 (hash_t key) {
+  return key & (CUCKOO_SIZE - 1);
+}
+
+inline uint32 cuckoo_h2 (hash_t key) {
+  return (key >> 16) & (CUCKOO_SIZE - 1);
+}
+
 ////////////////////////////////////
 // Patterns for use in evaluation //
 ////////////////////////////////////
@@ -377,4 +426,52 @@ shift_backward (bitboard b, Color c) {
   return (c == BLACK ? b << 8 : b >> 8);
 }
 
+// Return a bitboard shifted one file towards the H file.
+inline bitboard
+shift_east (bitboard b) {
+  return (b & ~file_mask (H)) << 1;
+}
+
+// Return a bitboard shifted one file towards the A file.
+inline bitboard
+shift_west (bitboard b) {
+  return (b & ~file_mask (A)) >> 1;
+}
+
+// Extend every set square forwards to the edge of the board.
+inline bitboard
+fill_forward (bitboard b, Color c) {
+  if (c == WHITE)
+    {
+      b |= b << 8;
+      b |= b << 16;
+      b |= b << 32;
+    }
+  else
+    {
+      b |= b >> 8;
+      b |= b >> 16;
+      b |= b >> 32;
+    }
+  return b;
+}
+
+// Return the squares strictly in front of any set square.
+inline bitboard
+span_forward (bitboard b, Color c) {
+  return fill_forward (shift_forward (b, c), c);
+}
+
+// Return the squares strictly behind any set square.
+inline bitboard
+span_backward (bitboard b, Color c) {
+  return fill_forward (shift_backward (b, c), ~c);
+}
+
+// Return every square on a file with a set square.
+inline bitboard
+fill_file (bitboard b) {
+  return fill_forward (b, WHITE) | fill_forward (b, BLACK);
+}
+
 #endif // __COMMON__
@@ -32,7 +32,14 @@ Session::bench (const string_vector &tokens) {
     depth = to_int (tokens[1]);
 
   se.set_fixed_time (1024 * 1024);
+  uint64 tests = king_attack_tests;
   se.compute_pv (board, depth, pv);
+  tests = king_attack_tests - tests;
+
+  // Report the cost of check and legality testing.
+  uint64 nodes = max (se.node_count (), (uint64) 1);
+  fprintf (out, "%llu king attack tests, %.2f per node\n",
+           (unsigned long long) tests, (double) tests / nodes);
   return true;
 }
 
@@ -138,50 +145,276 @@ Session::test_hashing (int d) {
   cout << pass << endl;
 }
 
+//////////////////////////////////////////////////////////////////
+// Time FEN parsing in place through a view against parsing the //
+// same strings after splitting them into tokens.               //
+//////////////////////////////////////////////////////////////////
+
+bool
+Session::fen_bench (const string_vector &tokens) {
+  static const char *fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+  };
+  const int n = sizeof (fens) / sizeof (fens[0]);
+  int count = 100000;
+  uint64 sum = 0;
+
+  if (tokens.size () > 1 && is_number (tokens[1]))
+    count = max (to_int (tokens[1]), 1);
+
+  uint64 start = cpu_time ();
+  for (int i = 0; i < count; i++)
+    sum += Board::from_fen (String_View (fens[i % n])).hash;
+  uint64 view_time = max (cpu_time () - start, (uint64) 1);
+
+  start = cpu_time ();
+  for (int i = 0; i < count; i++)
+    sum += Board::from_fen (tokenize (fens[i % n])).hash;
+  uint64 token_time = max (cpu_time () - start, (uint64) 1);
+
+  fprintf (out, "view:   %i positions in %.3f seconds, %.0f per second\n",
+           count, view_time / 1000.0, count * 1000.0 / view_time);
+  fprintf (out, "tokens: %i positions in %.3f seconds, %.0f per second\n",
+           count, token_time / 1000.0, count * 1000.0 / token_time);
+
+  return sum != 0;
+}
+
+/////////////////////////////////////////////////////////////////
+// Time applying every move from a set of positions, both to a //
+// copy of the board and in place followed by unapply.         //
+/////////////////////////////////////////////////////////////////
+
+bool
+Session::apply_bench (const string_vector &tokens) {
+  static const char *fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+  };
+  const int n = sizeof (fens) / sizeof (fens[0]);
+  int count = 1000000;
+  uint64 sum = 0;
+
+  if (tokens.size () > 1 && is_number (tokens[1]))
+    count = max (to_int (tokens[1]), 1);
+
+  Board boards[n];
+  vector <Move_Vector> moves;
+  moves.reserve (n);
+  for (int i = 0; i < n; i++)
+    {
+      boards[i] = Board::from_fen (String_View (fens[i]));
+      moves.push_back (Move_Vector (boards[i]));
+    }
+
+  // Apply count moves to copies of the boards.
+  int applied = 0;
+  uint64 start = cpu_time ();
+  while (applied < count)
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < moves[i].count; j++, applied++)
+        {
+          Board c = boards[i];
+          c.apply (moves[i][j]);
+          sum += c.hash;
+        }
+  uint64 copy_time = max (cpu_time () - start, (uint64) 1);
+
+  // Apply and unapply the same moves in place.
+  int unapplied = 0;
+  start = cpu_time ();
+  while (unapplied < count)
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < moves[i].count; j++, unapplied++)
+        {
+          Undo u;
+          boards[i].apply (moves[i][j], u);
+          sum += boards[i].hash;
+          boards[i].unapply (moves[i][j], u);
+        }
+  uint64 undo_time = max (cpu_time () - start, (uint64) 1);
+
+  fprintf (out, "copy:    %i moves in %.3f seconds, %.0f per second\n",
+           applied, copy_time / 1000.0, applied * 1000.0 / copy_time);
+  fprintf (out, "unapply: %i moves in %.3f seconds, %.0f per second\n",
+           unapplied, undo_time / 1000.0, unapplied * 1000.0 / undo_time);
+
+  return sum != 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Replay the games in a PGN file under each apply policy. After a //
+// resync, every policy must reach exactly the boards the full one //
+// does.                                                           //
+/////////////////////////////////////////////////////////////////////
+
+// The position a game starts from.
+static Board
+game_start (const Game &g, const Board &startpos) {
+  map <string, string>::const_iterator i = g.metadata.find ("FEN");
+  return i == g.metadata.end () ? startpos : Board::from_fen (i -> second);
+}
+
+// Compare every field of two boards, other than the cached check state.
+static bool
+same_board (const Board &a, const Board &b) {
+  return
+    a.white == b.white && a.black == b.black &&
+    a.pawns == b.pawns && a.rooks == b.rooks &&
+    a.knights == b.knights && a.bishops == b.bishops &&
+    a.queens == b.queens && a.kings == b.kings &&
+    a.occupied == b.occupied && a.occupied_45 == b.occupied_45 &&
+    a.occupied_90 == b.occupied_90 && a.occupied_135 == b.occupied_135 &&
+    a.flags.to_move == b.flags.to_move &&
+    a.flags.en_passant == b.flags.en_passant &&
+    a.flags.w_has_k_castled == b.flags.w_has_k_castled &&
+    a.flags.w_has_q_castled == b.flags.w_has_q_castled &&
+    a.flags.w_can_q_castle == b.flags.w_can_q_castle &&
+    a.flags.w_can_k_castle == b.flags.w_can_k_castle &&
+    a.flags.b_has_k_castled == b.flags.b_has_k_castled &&
+    a.flags.b_has_q_castled == b.flags.b_has_q_castled &&
+    a.flags.b_can_q_castle == b.flags.b_can_q_castle &&
+    a.flags.b_can_k_castle == b.flags.b_can_k_castle &&
+    a.half_move_clock == b.half_move_clock &&
+    a.full_move_clock == b.full_move_clock &&
+    a.hash == b.hash && a.phash == b.phash &&
+    !memcmp (a.material, b.material, sizeof (a.material)) &&
+    !memcmp (a.psquares, b.psquares, sizeof (a.psquares)) &&
+    !memcmp (a.piece_counts, b.piece_counts, sizeof (a.piece_counts)) &&
+    !memcmp (a.pawn_counts, b.pawn_counts, sizeof (a.pawn_counts));
+}
+
+// Replay every game passes times, leaving the final boards of the
+// last pass in finals. Returns the time taken.
+template <Apply_Policy P> static uint64
+replay_games (const vector <Game> &games, int passes,
+              vector <Board> &finals) {
+  const Board startpos = Board::startpos ();
+  finals.resize (games.size ());
+  uint64 start = cpu_time ();
+  for (int n = 0; n < passes; n++)
+    for (size_t i = 0; i < games.size (); i++)
+      {
+        Board b = game_start (games[i], startpos);
+        for (size_t j = 0; j < games[i].moves.size (); j++)
+          b.apply <P> (games[i].moves[j]);
+        finals[i] = b;
+      }
+  return max (cpu_time () - start, (uint64) 1);
+}
+
+bool
+Session::replay_test (const string_vector &tokens) {
+  if (tokens.size () < 2)
+    return false;
+
+  int passes = 10;
+  if (tokens.size () > 2 && is_number (tokens[2]))
+    passes = max (to_int (tokens[2]), 1);
+
+  PGN pgn;
+  pgn.open (tokens[1].c_str ());
+  if (pgn.status == PGN::FATAL_ERROR)
+    {
+      fprintf (out, "Could not open %s.\n", tokens[1].c_str ());
+      return false;
+    }
+
+  vector <Game> games;
+  uint64 moves = 0;
+  while (true)
+    {
+      Game g = pgn.read_game ();
+      if (pgn.status == PGN::END_OF_FILE || pgn.status == PGN::FATAL_ERROR)
+        break;
+      if (pgn.status != PGN::OK)
+        continue;
+      moves += g.moves.size ();
+      games.push_back (g);
+    }
+  pgn.close ();
+  moves *= passes;
+
+  static const char *names[] = { "full", "no hash", "placement" };
+  vector <Board> finals[3];
+  uint64 times[3];
+  times[0] = replay_games <APPLY_FULL> (games, passes, finals[0]);
+  times[1] = replay_games <APPLY_NO_HASH> (games, passes, finals[1]);
+  times[2] = replay_games <APPLY_PLACEMENT> (games, passes, finals[2]);
+
+  bool pass = true;
+  for (int p = 0; p < 3; p++)
+    {
+      int failures = 0;
+      for (size_t i = 0; i < games.size (); i++)
+        {
+          Board b = finals[p][i];
+          b.resync ();
+          if (!same_board (b, finals[0][i]))
+            failures++;
+        }
+      pass = pass && failures == 0;
+
+      fprintf (out, "%-10s %llu moves in %.3f seconds, %.0f per second, "
+               "%i of %i games differ\n", names[p],
+               (unsigned long long) moves, times[p] / 1000.0,
+               moves * 1000.0 / times[p], failures, (int) games.size ());
+    }
+
+  return pass;
+}
+
 //////////////////////////////////////////////////////////////////////
 // Process a string in Extended Position Notation. This can include //
 // tests, etc.                                                      //
 //////////////////////////////////////////////////////////////////////
 
 bool
-Session::epd (const string_vector &args)
+Session::epd (String_View args)
 {
-  string_vector tokens = rest (args);
-
   // The first 4 fields should be a truncated FEN string.
-  string fen = join (slice (tokens, 0, 3), " ");
-  tokens = slice (tokens, 4);
+  String_View tokens = args;
+  String_View first = next_token (tokens), last = first;
+  for (int i = 1; i < 4; i++)
+    last = next_token (tokens);
+  String_View fen (first.begin (), last.end () - first.begin ());
   Board b = Board::from_fen (fen, true);
 
   // Process EPD opcodes.
   while (1)
     {
+      String_View opcode = next_token (tokens);
+
       // Exit when we are out of tokens.
-      if (tokens.size () == 0)
+      if (opcode.empty ())
         {
           break;
         }
 
-      string opcode = first (tokens);
-      tokens = rest (tokens);
-
       //////////////////////////////////////////////
       // Opcode "D<digit> indicating a perft test //
       //////////////////////////////////////////////
 
       if (opcode[0] == 'D')
         {
-          if (opcode.length () != 2 || ! isdigit(opcode [1]))
+          if (opcode.size () != 2 || ! isdigit(opcode [1]))
             {
-              throw "Bad format in D<digit> opcode";
+              throw string ("Bad format in D<digit> opcode");
             }
           else
             {
-              string operand = first (tokens);
-              tokens = rest (tokens);
-              if (!is_number (operand))
+              String_View operand = next_token (tokens);
+              uint64 expecting;
+              if (!parse_uint (operand, expecting))
                 {
-                  throw "Bad operand in D<digit> opcode";
+                  throw string ("Bad operand in D<digit> opcode");
                 }
               else
                 {
@@ -190,19 +423,19 @@ Session::epd (const string_vector &args)
                   ///////////////////////////////////////
 
                   int depth = to_int (opcode [1]);
-                  uint64 expecting = to_int (operand);
                   // uint64 p = b.perft2 (depth);
                   uint64 p = b.perft (depth);
                   bool pass = (p == expecting);
 #ifdef _WIN32
                   fprintf (out, "%s %I64u\n", pass ? "PASS" : "FAIL", p);
 #else
-                  fprintf (out, "%s %llu\n", pass ? "PASS" : "FAIL", p);
+                  fprintf (out, "%s %llu\n", pass ? "PASS" : "FAIL",
+                           (unsigned long long) p);
 #endif // _WIN32
                   if (!pass)
                     fprintf  (out,
                               "Position %s fails at depth %i.\n",
-                              fen.c_str (), depth);
+                              fen.str ().c_str (), depth);
                 }
             }
         }
@@ -210,7 +443,7 @@ Session::epd (const string_vector &args)
       else if (opcode == "bm")
         {
           Move_Vector pv;
-          Move best = b.from_san (first (tokens));
+          Move best = b.from_san (next_token (tokens).str ());
 
           cout << "Trying " << fen << " bm " << b.to_san (best) << endl;
           se.reset ();
@@ -223,7 +456,6 @@ Session::epd (const string_vector &args)
           running = false;
           (pv[0] == best) ? cout << "PASS: " : cout << "FAIL: ";
           cout << fen << " bm " << b.to_san (best) << endl << endl;;
-          tokens = rest (tokens);
         }
 
       else
@@ -247,6 +479,7 @@ Board::perft (int d) const {
 
   if (d == 0) return 1;
 
+  checkers ();
   Move_Vector moves (*this);
   for (int i = 0; i < moves.count; i++)
     {
@@ -266,6 +499,7 @@ Board::perft2 (int d) {
 
   if (d == 0) return 1;
 
+  checkers ();
   Move_Vector moves (*this);
   for (int i = 0; i < moves.count; i++)
     {
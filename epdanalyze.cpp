@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// epdanalyze.cpp                                                             //
+//                                                                            //
+// Analyze each position in an EPD file and write a new EPD file recording    //
+// the results with the standard analysis opcodes: acd (depth), acn (nodes),  //
+// acs (seconds), ce (centipawn evaluation), dm (direct mate), pm (predicted  //
+// move) and pv (predicted variation). Positions are spread over worker       //
+// threads and written in input order.                                        //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "chesley.hpp"
+#include "pipeline.hpp"
+
+using namespace std;
+
+// Opcodes written by the analysis. Existing operations with these
+// opcodes are replaced.
+static bool
+is_analysis_opcode (String_View op) {
+  static const char *ops[] = { "acd", "acn", "acs", "ce", "dm", "pm", "pv" };
+  for (size_t i = 0; i < sizeof (ops) / sizeof (ops[0]); i++)
+    if (op == ops[i])
+      return true;
+  return false;
+}
+
+// Remove and return the next operation from s, which runs up to an
+// unquoted ';'. The terminator is not included.
+static String_View
+next_operation (String_View &s) {
+  const char *i = s.begin (), *end = s.end ();
+  bool quoted = false;
+
+  while (i < end && isspace (*i))
+    i++;
+
+  const char *start = i;
+  while (i < end && (quoted || *i != ';'))
+    {
+      if (*i == '\"')
+        quoted = !quoted;
+      i++;
+    }
+
+  String_View op (start, i - start);
+  s = String_View (i < end ? i + 1 : end, end - (i < end ? i + 1 : end));
+
+  // Trim trailing white space.
+  while (!op.empty () && isspace (op[op.size () - 1]))
+    op.len--;
+
+  return op;
+}
+
+struct EPD_Analyzer : public Pipeline <string> {
+
+  EPD_Analyzer (int nthreads, FILE *out, int depth, int64 nodes, int time) :
+    Pipeline <string> (nthreads, out),
+    depth (depth), nodes (nodes), time (time) {}
+
+  // Configure a worker's engine for depth, node and/or time limited
+  // search.
+  void init_engine (Search_Engine &se) {
+    if (time > 0)
+      {
+        se.set_fixed_time (time);
+      }
+    else
+      {
+        se.controls.mode = UNLIMITED;
+        se.controls.fixed_time = -1;
+      }
+    se.set_fixed_depth (depth);
+    se.set_fixed_nodes (nodes);
+  }
+
+  // Analyze one line, which may be an EPD record or a FEN string. If
+  // the line can not be analyzed it is written back unchanged.
+  string process (Search_Engine &se, const string &line) {
+    try
+      {
+        return analyze (se, line);
+      }
+    catch (string e)
+      {
+        fprintf (stderr, "Error analyzing \"%s\": %s\n",
+                 line.c_str (), e.c_str ());
+        return line + "\n";
+      }
+  }
+
+  string analyze (Search_Engine &se, const string &line) {
+    ostringstream s;
+
+    // The first four fields describe the position.
+    String_View rest (line);
+    String_View first = next_token (rest), last = first;
+    for (int i = 1; i < 4; i++)
+      last = next_token (rest);
+    if (last.empty ())
+      throw string ("too few fields");
+    String_View placement (first.begin (), last.end () - first.begin ());
+
+    // A FEN string also gives the move clocks, which are written
+    // as the hmvc and fmvn opcodes.
+    String_View ops = rest, clocks = rest;
+    uint64 half_moves = 0, full_moves = 0;
+    bool is_fen = parse_uint (next_token (clocks), half_moves) &&
+      parse_uint (next_token (clocks), full_moves);
+    if (is_fen)
+      ops = clocks;
+
+    Board b = Board::from_fen (placement, true);
+    if (!b.is_valid ())
+      throw string ("illegal position");
+    if (is_fen)
+      {
+        b.half_move_clock = half_moves;
+        b.full_move_clock = full_moves;
+      }
+
+    // Copy the position and any operations we do not replace.
+    s << placement;
+    if (is_fen)
+      s << " hmvc " << half_moves << "; fmvn " << full_moves << ";";
+
+    while (true)
+      {
+        String_View op = next_operation (ops);
+        if (op.empty ())
+          break;
+        String_View operands = op;
+        if (!is_analysis_opcode (next_token (operands)))
+          s << " " << op << ";";
+      }
+
+    // Search, unless the game is over.
+    Move_Vector pv;
+    Score score = 0;
+    uint64 start = mclock ();
+
+    if (b.child_count () == 0)
+      {
+        score = b.in_check (b.to_move ()) ? -MATE_VAL : 0;
+      }
+    else
+      {
+        se.rt.clear ();
+        score = se.compute_pv (b, MAX_DEPTH, pv);
+      }
+
+    uint64 elapsed = mclock () - start;
+
+    s << " acd " << (pv.count > 0 ? se.stats.depth : 0) << ";"
+      << " acn " << (pv.count > 0 ? se.node_count () : 0) << ";"
+      << " acs " << elapsed / 1000 << ";"
+      << " ce " << score << ";";
+
+    // A mate found by the search is given in moves, negative if the
+    // side to move is mated.
+    if (is_mate (score) && pv.count > 0)
+      {
+        int moves = (MATE_VAL - abs (score) + 1) / 2;
+        s << " dm " << (score > 0 ? moves : -moves) << ";";
+      }
+
+    // The predicted move and variation in SAN.
+    if (pv.count > 0)
+      {
+        Board c = b;
+        s << " pm " << b.to_san (pv[0]) << "; pv";
+        for (int i = 0; i < pv.count; i++)
+          {
+            s << " " << c.to_san (pv[i]);
+            if (!c.apply (pv[i]))
+              break;
+          }
+        s << ";";
+      }
+
+    s << "\n";
+    return s.str ();
+  }
+
+  const int depth;
+  const int64 nodes;
+  const int time;
+};
+
+////////////////////////////////////////////////////////////////////
+// Analyze the positions in an EPD file. Usage:                   //
+//                                                                //
+//   epdanalyze <epd> [out <file>] [depth <d>] [nodes <n>]        //
+//              [time <ms>] [threads <t>]                         //
+////////////////////////////////////////////////////////////////////
+
+bool
+Session::epd_analyze (const string_vector &tokens) {
+  string in_name, out_name;
+  int depth = -1;
+  int64 nodes = -1;
+  int time = -1;
+  int threads = max ((int) thread::hardware_concurrency (), 1);
+
+  if (tokens.size () < 2)
+    {
+      fprintf (out, "Usage: epdanalyze <epd> [out <file>] [depth <d>] "
+               "[nodes <n>] [time <ms>] [threads <t>]\n");
+      return false;
+    }
+
+  in_name = tokens[1];
+  for (size_t i = 2; i + 1 < tokens.size (); i += 2)
+    {
+      if (tokens[i] == "out")
+        out_name = tokens[i + 1];
+      else if (tokens[i] == "depth")
+        depth = to_int (tokens[i + 1]);
+      else if (tokens[i] == "nodes")
+        nodes = atoll (tokens[i + 1].c_str ());
+      else if (tokens[i] == "time")
+        time = to_int (tokens[i + 1]);
+      else if (tokens[i] == "threads")
+        threads = to_int (tokens[i + 1]);
+    }
+
+  // Without a limit every search would run forever.
+  if (depth <= 0 && nodes <= 0 && time <= 0)
+    depth = 6;
+
+  FILE *in = fopen (in_name.c_str (), "r");
+  if (!in)
+    {
+      fprintf (out, "Error: could not open %s\n", in_name.c_str ());
+      return false;
+    }
+
+  FILE *fp = out;
+  if (!out_name.empty () && !(fp = fopen (out_name.c_str (), "w")))
+    {
+      fprintf (out, "Error: could not open %s\n", out_name.c_str ());
+      fclose (in);
+      return false;
+    }
+
+  uint64 start = mclock ();
+  EPD_Analyzer analyzer (threads, fp, depth, nodes, time);
+  analyzer.start ();
+
+  // Queue each non-blank line.
+  while (char *line = get_line (in))
+    {
+      string epd = trim (line);
+      free (line);
+      if (epd.length () > 0)
+        analyzer.push (epd);
+    }
+
+  analyzer.finish ();
+  fclose (in);
+  if (fp != out)
+    fclose (fp);
+
+  fprintf (out, "Analyzed %llu positions in %.2f seconds.\n",
+           (unsigned long long) analyzer.jobs_done,
+           (mclock () - start) / 1000.0);
+
+  return true;
+}
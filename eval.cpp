@@ -15,13 +15,6 @@
 
 using namespace std;
 
-/////////////////////
-// Data structures //
-/////////////////////
-
-// The pawn evaluation cache.
-PHash ph (1024 * 1024);
-
 #define PSQ 1
 #define MOB 1
 #define PWN 1
@@ -525,7 +518,10 @@ Eval::score_pawns () {
   return s;
 }
 
-// Evaluate pawn structure.
+// Evaluate pawn structure. Each feature is computed for all of c's
+// pawns at once as a bitboard. Only passed and connected pawns are
+// then visited one by one, to look up their bonus by rank, and weak
+// pawns are simply counted.
 Score
 Eval::score_pawns_inner (const Color c) {
   Score s = 0;
@@ -533,150 +529,113 @@ Eval::score_pawns_inner (const Color c) {
   const bitboard our_pawns = b.get_pawns (c);
   const bitboard their_pawns = b.get_pawns (~c);
 
-  bitboard i = our_pawns;
-  while (i) {
-    Coord idx = bit_idx (i);
-    Score val = 0;
-
-    //////////////////////////////
-    // Pawn structure features. //
-    //////////////////////////////
-
-    bool backward = false;
-    bool connected = false;
-    bool doubled = false;
-    bool isolated = false;
-    bool passed = false;
-
-    const Coord rank = idx_to_rank (idx);
-    const Coord file = idx_to_file (idx);
-
-    // A mask of the two square directly adjacent to this pawn.
-    const bitboard beside_mask =
-      rank_mask (rank) & adjacent_files_mask (idx);
-
-    // A mask of the pawns one square ahead-right and one square
-    // ahead-left of this pawn.
-    const bitboard front_neighbors_mask =
-      shift_forward (beside_mask, c) & our_pawns;
+  //////////////////////////////
+  // Pawn structure features. //
+  //////////////////////////////
 
-    // Is there an empty square in front of this pawn?
-    const bool can_advance =
-      test_bit (b.unoccupied (), forward (idx, c));
+  // The squares directly to either side of one of our pawns.
+  const bitboard beside_ours = shift_east (our_pawns) | shift_west (our_pawns);
 
-    // A mask of all the squares on this and the two adjacent files
-    // which are further forward than this pawn.
-    const bitboard front_span =
-      (this_file_mask (idx) | adjacent_files_mask (idx)) &
-      in_front_of_mask(idx, c);
+  // Pawns with one of ours directly beside them.
+  const bitboard beside = our_pawns & beside_ours;
 
-    // A mask of the squares attack by enemy pawns.
-    const bitboard their_attacks = b.get_pawn_attacks (~c);
+  // Pawns with one of ours one square ahead-right or ahead-left.
+  const bitboard front_neighbors =
+    our_pawns & shift_backward (beside_ours, c);
 
-    ///////////////////
-    // Doubled pawns //
-    ///////////////////
+  // Pawns defended by one of ours.
+  const bitboard defended = our_pawns & shift_forward (beside_ours, c);
 
-    if (b.pawn_counts[c][file] > 1)
-      doubled = true;
+  // Pawns with an empty square in front of them.
+  const bitboard can_advance =
+    our_pawns & shift_backward (b.unoccupied (), c);
 
-    //////////////////
-    // Passed pawns //
-    //////////////////
+  // Pawns which could be taken by an enemy pawn after advancing.
+  const bitboard stop_attacked =
+    our_pawns & shift_backward (b.get_pawn_attacks (~c), c);
 
-    // This pawn is passed if there are no enemy pawns in it's front
-    // span.
-    if (!(front_span & their_pawns))
-      passed = true;
+  ///////////////////
+  // Doubled pawns //
+  ///////////////////
 
-    /////////////////////
-    // Backwards pawns //
-    /////////////////////
+  // Every pawn on a file where one of ours stands behind another.
+  const bitboard doubled =
+    our_pawns & fill_file (our_pawns & span_forward (our_pawns, c));
 
-    if (
-        // This can advance
-        can_advance
+  //////////////////
+  // Passed pawns //
+  //////////////////
 
-        // And advancing it would place it besides a pawn.
-        && front_neighbors_mask != 0
+  // A pawn is passed if there are no enemy pawns in its front span,
+  // that is if it is not behind an enemy pawn on its own or an
+  // adjacent file.
+  const bitboard passed = our_pawns &
+    ~span_backward (their_pawns | shift_east (their_pawns) |
+                    shift_west (their_pawns), c);
 
-        // And doing so would leave it unprotected.
-        && !(beside_mask & our_pawns)
+  /////////////////////
+  // Backwards pawns //
+  /////////////////////
 
-        // And it could be taken by a pawn.
-        && test_bit (their_attacks, forward (idx, c)))
+  // A pawn is backward if it can advance, and advancing it would
+  // place it beside a pawn, and doing so would leave it unprotected
+  // and open to capture by a pawn.
+  const bitboard backward =
+    can_advance & front_neighbors & ~beside & stop_attacked;
 
-      {
-        backward = true;
-      }
-
-    //////////////////////
-    // Connected pawns. //
-    //////////////////////
-
-    else if (
-
-        // This pawn is connected if there is a pawn beside it.
-        (beside_mask & our_pawns)
-
-        // Or if it is defended by a pawn
-        || (shift_backward (beside_mask, c) & our_pawns)
+  //////////////////////
+  // Connected pawns. //
+  //////////////////////
 
-        // Or if it can advanced and place itself directly beside a pawn
-        // and is not backwards.
-        || (can_advance && front_neighbors_mask)
+  // A pawn which is not backward is connected if there is a pawn
+  // beside it, or it is defended by a pawn, or it can advance and
+  // place itself directly beside a pawn.
+  const bitboard connected = ~backward &
+    (beside | defended | (can_advance & front_neighbors));
 
-        )
+  /////////////////////
+  // Isolated pawns. //
+  /////////////////////
 
-      {
-        connected = true;
-      }
+  // A pawn is isolated if there are no pawns of the same color on
+  // the adjacent files.
+  const bitboard our_files = fill_file (our_pawns);
+  const bitboard isolated =
+    our_pawns & ~(shift_east (our_files) | shift_west (our_files));
 
-    /////////////////////
-    // Isolated pawns. //
-    /////////////////////
+  //////////////////////////////
+  // Apply score adjustments. //
+  //////////////////////////////
 
-    // This pawn is isolated if there are no pawns of the same color
-    // on the adjacent files.
-    if (!(adjacent_files_mask (idx) & our_pawns))
-        isolated = true;
-
-    //////////////////////////////
-    // Apply score adjustments. //
-    //////////////////////////////
-
-    if (passed && connected)
-      {
-        val = PASSED_CONNECTED_VAL[c][rank];
-      }
-    else if (passed)
-      {
-        val = PASSED_VAL[c][rank];
-      }
-    else if (connected)
-      {
-        val = CONNECTED_VAL[c][rank];
-      }
+  bitboard scored = passed | connected;
+  while (scored)
+    {
+      const Coord idx = bit_idx (scored);
+      const int rank = idx_to_rank (idx);
+      if (!test_bit (connected, idx))
+        s += PASSED_VAL[c][rank];
+      else if (!test_bit (passed, idx))
+        s += CONNECTED_VAL[c][rank];
+      else
+        s += PASSED_CONNECTED_VAL[c][rank];
+      clear_bit (scored, idx);
+    }
 
-    // Weak pawns
-    if (backward || isolated || doubled)
-      val -= WEAK_PAWN_VAL;
+  // Weak pawns
+  s -= WEAK_PAWN_VAL * (int) pop_count (backward | isolated | doubled);
 
 #ifdef TRACE_EVAL
+  bitboard i = our_pawns;
+  while (i) {
+    Coord idx = bit_idx (i);
     cerr << c << " pawn at " << b.to_alg_coord (idx) << ":";
-    cerr << (connected ? " connected" : "");
-    cerr << (doubled ? " doubled" : "");
-    cerr << (isolated ? " isolated" : "");
-    cerr << (passed ? " passed" : "");
-    cerr << " (bonus " << val << ")" << endl;
-#endif
-
-    s += val;
-
+    cerr << (test_bit (connected, idx) ? " connected" : "");
+    cerr << (test_bit (doubled, idx) ? " doubled" : "");
+    cerr << (test_bit (isolated, idx) ? " isolated" : "");
+    cerr << (test_bit (passed, idx) ? " passed" : "");
+    cerr << endl;
     clear_bit (i, idx);
   }
-
-#ifdef TRACE_EVAL
   cerr << endl;
 #endif
 
@@ -18,6 +18,7 @@
 #define _EVAL_
 
 #include "chesley.hpp"
+#include "phash.hpp"
 
 // Bounds on the Score type.
 
@@ -106,9 +107,10 @@ inline Score net_material (const Board &b) {
 
 struct Eval {
 
-  // Initialize the evaluation object.
-  Eval (const Board &b, Score alpha = -INF, Score beta = -INF) :
-    b (b), alpha (alpha), beta (beta), s (0), s_op (0), s_eg (0) {}
+  // Initialize the evaluation object. Pawn structure scores are
+  // cached in ph, which should not be shared between threads.
+  Eval (const Board &b, PHash &ph, Score alpha = -INF, Score beta = -INF) :
+    b (b), ph (ph), alpha (alpha), beta (beta), s (0), s_op (0), s_eg (0) {}
 
   // Return the static evaluation of this position.
   Score score ();
@@ -116,6 +118,7 @@ struct Eval {
 private:
 
   const Board &b;
+  PHash &ph;
   const Score alpha;
   const Score beta;
 
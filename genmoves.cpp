@@ -23,6 +23,8 @@
 
 using namespace std;
 
+thread_local uint64 king_attack_tests = 0;
+
 // Collect all possible moves.
 void
 Board::gen_moves (Move_Vector &moves) const
@@ -571,6 +573,10 @@ int
 Board::child_count () const
 {
   int count = 0;
+
+  // Children share this position's check state, letting apply skip
+  // most legality tests.
+  checkers ();
   Move_Vector moves (*this);
 
   for (int i = 0; i < moves.count; i++)
@@ -648,10 +654,64 @@ Board::least_valuable_attacker (Coord sqr) const {
   return NULL_MOVE;
 }
 
-// Return whether color c is in check.
+// Return the squares from which a pawn of color c would attack idx:
+// one rank behind it, from c's point of view, on an adjacent file.
+static inline bitboard
+pawn_origins (Coord idx, Color c)
+{
+  if (c == WHITE)
+    return (((masks_0[idx] & ~file_mask (H)) >> 7) |
+            ((masks_0[idx] & ~file_mask (A)) >> 9));
+  else
+    return (((masks_0[idx] & ~file_mask (A)) << 7) |
+            ((masks_0[idx] & ~file_mask (H)) << 9));
+}
+
+// Return the pieces of color c which stand alone between the square
+// idx and a slider of color s able to reach it along an empty line.
+static bitboard
+blockers_for (const Board &b, Coord idx, Color s, Color c)
+{
+  bitboard result = 0;
+  bitboard sliders = b.color_to_board (s) &
+    (((RANK_ATTACKS_TBL[idx * 256] | FILE_ATTACKS_TBL[idx * 256])
+      & (b.rooks | b.queens)) |
+     ((DIAG_45_ATTACKS_TBL[idx * 256] | DIAG_135_ATTACKS_TBL[idx * 256])
+      & (b.bishops | b.queens)));
+
+  while (sliders)
+    {
+      Coord sq = bit_idx (sliders);
+      bitboard between_us = between[idx * 64 + sq] & b.occupied;
+      if (between_us && !(between_us & (between_us - 1)) &&
+          (between_us & b.color_to_board (c)))
+        result |= between_us;
+      clear_bit (sliders, sq);
+    }
+
+  return result;
+}
+
+// Return the pieces of color c attacking the square idx.
+bitboard
+Board::attackers (Coord idx, Color c) const
+{
+  bitboard them = color_to_board (c);
+  return them & ((pawn_origins (idx, c) & pawns) |
+                 (rook_attacks   (idx) & (queens | rooks))   |
+                 (bishop_attacks (idx) & (queens | bishops)) |
+                 (knight_attacks (idx) & knights)            |
+                 (king_attacks   (idx) & kings));
+}
+
+// Return whether color c is in check. The side to move's check state
+// is cached.
 bool
 Board::in_check (Color c) const
 {
+  if (c == to_move ())
+    return checkers () != 0;
+
   Coord idx = king_square (c);
 
   if (idx >= 64)
@@ -667,5 +727,106 @@ Board::in_check (Color c) const
       assert (0);
     }
 
+  king_attack_tests++;
   return is_attacked (idx, invert (c));
 }
+
+// Compute the checkers and pinned pieces for the side to move. A piece
+// is pinned if it is the only piece standing between its king and an
+// enemy slider.
+void
+Board::compute_check_state () const
+{
+  const Color c = to_move ();
+  const Coord k = king_square (c);
+
+  king_attack_tests++;
+  checkers_bb = 0;
+  pinned_bb = 0;
+
+  if (k < 64)
+    {
+      checkers_bb = attackers (k, invert (c));
+      pinned_bb = blockers_for (*this, k, invert (c), c);
+    }
+
+  check_key = hash;
+}
+
+// Return whether a pseudo-legal move is legal. Only moves which the
+// cached check state can't vouch for are made on a copy of the board.
+bool
+Board::is_legal (const Move &m) const
+{
+  if (!checkers () && m.get_kind () != KING && !m.is_en_passant () &&
+      !(pinned () & masks_0[m.from]))
+    return true;
+
+  Board c = *this;
+  return c.apply (m);
+}
+
+Board::Check_Info::Check_Info (const Board &b)
+{
+  const Color c = b.to_move ();
+  ksq = b.king_square (invert (c));
+
+  if (ksq >= 64)
+    {
+      memset (squares, 0, sizeof (squares));
+      discoverers = 0;
+      return;
+    }
+
+  squares[PAWN]   = pawn_origins (ksq, c);
+  squares[KNIGHT] = b.knight_attacks (ksq);
+  squares[BISHOP] = b.bishop_attacks (ksq);
+  squares[ROOK]   = b.rook_attacks (ksq);
+  squares[QUEEN]  = squares[BISHOP] | squares[ROOK];
+  squares[KING]   = 0;
+  discoverers = blockers_for (b, ksq, c, c);
+}
+
+// Return whether a, b and c lie on one rank, file or diagonal.
+static inline bool
+aligned (Coord a, Coord b, Coord c)
+{
+  return ((between[a * 64 + b] & masks_0[c]) ||
+          (between[a * 64 + c] & masks_0[b]) ||
+          (between[b * 64 + c] & masks_0[a]));
+}
+
+// Return whether a move gives check. A move checks directly if it
+// lands on a checking square for its kind, and by discovery if it
+// takes a blocker off the line between the king and a slider. Castling,
+// promotion and en passant move a second piece or change one, and are
+// rare enough to settle by making the move.
+bool
+Board::gives_check (const Move &m, const Check_Info &ci) const
+{
+  if (ci.ksq >= 64)
+    return false;
+
+  if (m.is_castle () || m.get_promote () != NULL_KIND || m.is_en_passant ())
+    {
+      Board c = *this;
+      c.apply (m);
+      return c.in_check (c.to_move ());
+    }
+
+  if (ci.squares[m.get_kind ()] & masks_0[m.to])
+    return true;
+
+  return ((ci.discoverers & masks_0[m.from]) &&
+          !aligned (m.from, m.to, ci.ksq));
+}
+
+// Return whether this is a position which can be searched.
+bool
+Board::is_valid () const
+{
+  if (pop_count (kings & white) != 1 || pop_count (kings & black) != 1)
+    return false;
+
+  return !in_check (~to_move ());
+}
@@ -72,11 +72,20 @@ uint64  zobrist_w_castle_k_key;
 uint64  zobrist_b_castle_q_key;
 uint64  zobrist_b_castle_k_key;
 
+// Tables used to update a position as a piece moves.
+uint64 *zobrist_move_keys;
+int32  *psq_move_deltas;
+
 // Tables used during evaluation.
 bitboard *pawn_attack_spans[2];
 bitboard *in_front_of[2];
 bitboard *adjacent_files;
 
+// Tables used to detect repetitions.
+bitboard *between;
+hash_t *cuckoo_keys;
+uint16 *cuckoo_moves;
+
 ////////////////////
 // Initialization //
 ////////////////////
@@ -114,11 +123,18 @@ static void init_mobility_tables ();
 // Zobrist keys.
 static void init_zobrist_keys ();
 
+// Move delta tables.
+static void init_move_deltas ();
+
 // Evaluation tables.
 static void init_in_front_of ();
 static void init_pawn_attack_spans ();
 static void init_adjacent_files ();
 
+// Repetition detection tables.
+static void init_between ();
+static void init_cuckoo_tables ();
+
 // Precompute all tables.
 void
 precompute_tables () {
@@ -148,9 +164,12 @@ precompute_tables () {
 
   init_mobility_tables ();
   init_zobrist_keys ();
+  init_move_deltas ();
   init_pawn_attack_spans ();
   init_in_front_of ();
   init_adjacent_files ();
+  init_between ();
+  init_cuckoo_tables ();
 
   have_precomputed_tables = true;
 }
@@ -815,6 +834,39 @@ init_zobrist_keys () {
   zobrist_b_castle_k_key = random64 ();
 }
 
+////////////////////////////////
+// Generate move delta tables //
+////////////////////////////////
+
+// Tabulate the change in hash key and in piece square scores made by
+// moving each kind of piece between each pair of squares.
+static void
+init_move_deltas () {
+  // Allocate tables.
+  zobrist_move_keys = new uint64[2 * 6 * 64 * 64];
+  psq_move_deltas = new int32[2 * 6 * 64 * 64];
+
+  for (int c = WHITE; c <= BLACK; c++)
+    for (int k = PAWN; k <= KING; k++)
+      for (Coord from = 0; from < 64; from++)
+        for (Coord to = 0; to < 64; to++)
+          {
+            uint32 i = move_delta_index ((Color) c, (Kind) k, from, to);
+
+            zobrist_move_keys[i] =
+              get_zobrist_piece_key ((Color) c, (Kind) k, from) ^
+              get_zobrist_piece_key ((Color) c, (Kind) k, to);
+
+            Score op =
+              piece_square_value (OPENING_PHASE, (Kind) k, (Color) c, to) -
+              piece_square_value (OPENING_PHASE, (Kind) k, (Color) c, from);
+            Score eg =
+              piece_square_value (END_PHASE, (Kind) k, (Color) c, to) -
+              piece_square_value (END_PHASE, (Kind) k, (Color) c, from);
+            psq_move_deltas[i] = (int32) ((uint32) op << 16) + eg;
+          }
+}
+
 //////////////////////////////
 // Generate mobility tables //
 //////////////////////////////
@@ -950,3 +1002,82 @@ init_adjacent_files () {
         }
     }
 }
+
+////////////////////////////////////////
+// Generate repetition detection data //
+////////////////////////////////////////
+
+// Build a table indexed by [from * 64 + to] of the squares strictly
+// between two squares which share a rank, file or diagonal.
+static void
+init_between () {
+  // Allocate table.
+  between = new bitboard[64 * 64];
+
+  for (Coord from = 0; from < 64; from++)
+    for (Coord to = 0; to < 64; to++)
+      {
+        int dr = idx_to_rank (to) - idx_to_rank (from);
+        int df = idx_to_file (to) - idx_to_file (from);
+        between[from * 64 + to] = 0;
+
+        if (from == to || (dr != 0 && df != 0 && abs (dr) != abs (df)))
+          continue;
+
+        int sr = (dr > 0) - (dr < 0), sf = (df > 0) - (df < 0);
+        int r = idx_to_rank (from) + sr, f = idx_to_file (from) + sf;
+        while (to_idx (r, f) != to)
+          {
+            between[from * 64 + to] |= masks_0[to_idx (r, f)];
+            r += sr;
+            f += sf;
+          }
+      }
+}
+
+// Build the cuckoo tables. A key displaced from its slot by an insert
+// moves to its other slot, and so on until a free slot is found.
+static void
+init_cuckoo_tables () {
+  // Allocate tables.
+  cuckoo_keys = new hash_t[CUCKOO_SIZE];
+  cuckoo_moves = new uint16[CUCKOO_SIZE];
+  memset (cuckoo_keys, 0, CUCKOO_SIZE * sizeof (hash_t));
+  memset (cuckoo_moves, 0, CUCKOO_SIZE * sizeof (uint16));
+
+  for (int c = WHITE; c <= BLACK; c++)
+    for (int k = ROOK; k <= KING; k++)
+      for (Coord from = 0; from < 64; from++)
+        for (Coord to = from + 1; to < 64; to++)
+          {
+            // Can this piece move from one square to the other?
+            int dr = abs (idx_to_rank (to) - idx_to_rank (from));
+            int df = abs (idx_to_file (to) - idx_to_file (from));
+            bool straight = dr == 0 || df == 0;
+            bool diagonal = dr == df;
+            bool legal =
+              (k == ROOK   && straight) ||
+              (k == BISHOP && diagonal) ||
+              (k == QUEEN  && (straight || diagonal)) ||
+              (k == KNIGHT && test_bit (KNIGHT_ATTACKS_TBL[from], to)) ||
+              (k == KING   && test_bit (KING_ATTACKS_TBL[from], to));
+            if (!legal)
+              continue;
+
+            hash_t key =
+              get_zobrist_piece_key ((Color) c, (Kind) k, from) ^
+              get_zobrist_piece_key ((Color) c, (Kind) k, to) ^
+              zobrist_key_white_to_move;
+            uint16 move = from | to << 6;
+
+            uint32 i = cuckoo_h1 (key);
+            while (true)
+              {
+                std::swap (cuckoo_keys[i], key);
+                std::swap (cuckoo_moves[i], move);
+                if (move == 0)
+                  break;
+                i = (i == cuckoo_h1 (key)) ? cuckoo_h2 (key) : cuckoo_h1 (key);
+              }
+          }
+}
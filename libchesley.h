@@ -0,0 +1,76 @@
+/******************************************************************************/
+/*                                                                            */
+/* libchesley.h                                                               */
+/*                                                                            */
+/* A C interface to the engine for embedding in other programs. Each engine   */
+/* handle owns its own position, search state and hash tables, so any number  */
+/* of handles may be used concurrently from different threads. A single       */
+/* handle must not be used from two threads at once, with the exception of    */
+/* chesley_stop.                                                              */
+/*                                                                            */
+/* Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   */
+/* the Chess Engine! is free software distributed under the terms of the      */
+/* GNU Public License.                                                        */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef _LIBCHESLEY_H_
+#define _LIBCHESLEY_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* An opaque engine handle. */
+typedef struct chesley_engine chesley_engine;
+
+/* Create an engine set up at the initial position, with a
+   transposition table of hash_entries entries or the default size if
+   hash_entries is zero. Returns NULL if memory is exhausted. */
+chesley_engine *chesley_create (size_t hash_entries);
+
+/* Release an engine and all of its memory. */
+void chesley_destroy (chesley_engine *e);
+
+/* Set the position to fen, or to the initial position if fen is NULL,
+   then play moves, a space separated list of moves in coordinate
+   algebraic notation which may be NULL. Returns 0 on success or -1 if
+   the position or a move is invalid, in which case the position is
+   unchanged. */
+int chesley_set_position (chesley_engine *e, const char *fen,
+                          const char *moves);
+
+/* Search the current position until any of the following limits is
+   reached: depth plies, nodes nodes, or movetime_ms milliseconds. A
+   limit of zero or less is ignored. If no limit is given the search
+   runs until chesley_stop is called. Blocks until the search ends and
+   returns 0 on success or -1 on error. */
+int chesley_search (chesley_engine *e, int depth, long long nodes,
+                    int movetime_ms);
+
+/* Ask a search running in another thread, or about to start, to return
+   as soon as it has completed at least one iteration. */
+void chesley_stop (chesley_engine *e);
+
+/* Results of the last search. The score is in centipawns from the
+   point of view of the side to move. */
+int chesley_get_score (const chesley_engine *e);
+int chesley_get_depth (const chesley_engine *e);
+long long chesley_get_nodes (const chesley_engine *e);
+
+/* Write the principal variation of the last search as a NUL terminated,
+   space separated list of moves in coordinate algebraic notation into
+   buf, truncating to len bytes. Returns the length of the full string,
+   which is empty if the game is over. */
+size_t chesley_get_pv (const chesley_engine *e, char *buf, size_t len);
+
+/* Return a description of the last error on this handle. */
+const char *chesley_last_error (const chesley_engine *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LIBCHESLEY_H_ */
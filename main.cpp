@@ -18,9 +18,6 @@
 
 using namespace std;
 
-// Globals.
-char *arg0;
-
 // Initialization.
 void initialize_all ()
  {
@@ -36,12 +33,54 @@ void initialize_all ()
  }
 
 // Initialize and pass control to main loop.
-int main(int argc IS_UNUSED, char **argv)
+int main(int argc, char **argv)
 {
   arg0 = argv[0];
 
   try
     {
+      // Analyze positions from standard input in batch mode.
+      if (argc > 1 && string (argv[1]) == "batch")
+        {
+          precompute_tables ();
+          return batch_main (argc - 1, argv + 1);
+        }
+
+      // Run prioritized analysis jobs within a CPU budget.
+      if (argc > 1 && string (argv[1]) == "schedule")
+        {
+          precompute_tables ();
+          return schedule_main (argc - 1, argv + 1);
+        }
+
+      // Filter and deduplicate a PGN file.
+      if (argc > 1 && string (argv[1]) == "pgnfilter")
+        {
+          precompute_tables ();
+          return pgnfilter_main (argc - 1, argv + 1);
+        }
+
+      // Analyze a position with several cooperating processes.
+      if (argc > 1 && string (argv[1]) == "cluster")
+        {
+          precompute_tables ();
+          return cluster_main (argc - 1, argv + 1);
+        }
+
+      // Measure search speed as threads are added node by node.
+      if (argc > 1 && string (argv[1]) == "numabench")
+        {
+          precompute_tables ();
+          return numabench_main (argc - 1, argv + 1);
+        }
+
+      // Serve analysis clients over a Unix domain socket.
+      if (argc > 1 && string (argv[1]) == "server")
+        {
+          precompute_tables ();
+          return server_main (argc - 1, argv + 1);
+        }
+
       initialize_all ();
       Session::cmd_loop ();
     }
@@ -0,0 +1,340 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// mate.cpp                                                                   //
+//                                                                            //
+// A mate solver using depth-first proof-number search (df-pn). Each node     //
+// carries a proof number, the least number of leaves which must be shown     //
+// to be mates to prove the node, and a disproof number, the least number     //
+// which must be refuted to disprove it. Search always expands the most       //
+// proving child and backs up as soon as a threshold is exceeded, keeping     //
+// its state in a transposition table rather than in an explicit tree.        //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "chesley.hpp"
+
+using namespace std;
+
+// Add proof or disproof numbers, saturating at infinity.
+static inline uint32
+sum (uint64 a, uint64 b, uint32 inf) {
+  return (uint32) min (a + b, (uint64) inf);
+}
+
+Mate_Solver :: Mate_Solver (size_t size) :
+  max_nodes (-1), nodes (0), size (size), aborted (false) {
+  table = (Entry *) calloc (size, sizeof (Entry));
+}
+
+Mate_Solver :: ~Mate_Solver () {
+  free (table);
+}
+
+// Clear the transposition table.
+void
+Mate_Solver :: clear () {
+  memset (table, 0, size * sizeof (Entry));
+}
+
+// Return the key for a position with rem plies remaining.
+hash_t
+Mate_Solver :: key (const Board &b, int rem) {
+  return b.hash ^ ((hash_t) (rem + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Look up a position, returning false if it is not in the table.
+bool
+Mate_Solver :: lookup (const Board &b, int rem, uint32 &pn, uint32 &dn) const {
+  hash_t k = key (b, rem);
+  const Entry &e = table[k % size];
+  if (e.key != k)
+    return false;
+  pn = e.pn;
+  dn = e.dn;
+  return true;
+}
+
+// Store the proof and disproof numbers for a position.
+void
+Mate_Solver :: store (const Board &b, int rem, uint32 pn, uint32 dn) {
+  hash_t k = key (b, rem);
+  Entry &e = table[k % size];
+  e.key = k;
+  e.pn = pn;
+  e.dn = dn;
+}
+
+// Generate the legal children of a position: checks if the attacker is
+// to move, otherwise every legal move.
+void
+Mate_Solver :: children (const Board &b, bool attacker, Move_Vector &moves,
+                         vector <Board> &boards) const {
+  Move_Vector all (b);
+  const Board::Check_Info ci (b);
+  moves.clear ();
+  boards.clear ();
+
+  for (int i = 0; i < all.count; i++)
+    {
+      // Rule out the attacker's quiet moves before copying the board.
+      if (attacker && !b.gives_check (all[i], ci))
+        continue;
+      Board c = b;
+      if (!c.apply (all[i]))
+        continue;
+      moves.push (all[i]);
+      boards.push_back (c);
+    }
+}
+
+// Fetch a child's proof and disproof numbers.
+void
+Mate_Solver :: child_numbers
+(const Board &c, int rem, uint32 &pn, uint32 &dn) const {
+  if (!lookup (c, rem, pn, dn))
+    pn = dn = 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+// Mate_Solver :: mid ()                                              //
+//                                                                    //
+// Expand the most proving child of b until b's proof number reaches  //
+// thpn or its disproof number reaches thdn. At an attacker's node    //
+// the proof number is the least of the children's and the disproof  //
+// number their sum. At a defender's node the reverse is true.        //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+void
+Mate_Solver :: mid (const Board &b, int rem, bool attacker,
+                    uint32 thpn, uint32 thdn, uint32 &pn, uint32 &dn) {
+  Move_Vector moves;
+  vector <Board> boards;
+
+  nodes++;
+  if (max_nodes > 0 && (int64) nodes >= max_nodes)
+    aborted = true;
+
+  // The attacker has no moves left.
+  if (attacker && rem <= 0)
+    {
+      pn = INFINITE;
+      dn = 0;
+      store (b, rem, pn, dn);
+      return;
+    }
+
+  children (b, attacker, moves, boards);
+
+  // An attacker without a check has failed. A defender without a
+  // move is mated, since every move by the attacker gives check.
+  if (moves.count == 0)
+    {
+      pn = attacker ? INFINITE : 0;
+      dn = attacker ? 0 : INFINITE;
+      store (b, rem, pn, dn);
+      return;
+    }
+
+  // The defender has escaped.
+  if (!attacker && rem <= 0)
+    {
+      pn = INFINITE;
+      dn = 0;
+      store (b, rem, pn, dn);
+      return;
+    }
+
+  while (true)
+    {
+      // Compute this node's numbers and find the two most proving
+      // children.
+      uint32 best = INFINITE + 1, second = INFINITE;
+      uint32 best_pn = 0, best_dn = 0;
+      int best_i = -1;
+      uint64 total = 0;
+
+      for (int i = 0; i < moves.count; i++)
+        {
+          uint32 cpn, cdn;
+          child_numbers (boards[i], rem - 1, cpn, cdn);
+
+          // The number to minimize, and the number to sum.
+          uint32 v = attacker ? cpn : cdn;
+          total += attacker ? cdn : cpn;
+
+          if (v < best)
+            {
+              second = best;
+              best = v;
+              best_i = i;
+              best_pn = cpn;
+              best_dn = cdn;
+            }
+          else if (v < second)
+            {
+              second = v;
+            }
+        }
+
+      uint32 t = (uint32) min (total, (uint64) INFINITE);
+      pn = attacker ? best : t;
+      dn = attacker ? t : best;
+      pn = min (pn, INFINITE);
+      dn = min (dn, INFINITE);
+
+      if (pn >= thpn || dn >= thdn || aborted)
+        break;
+
+      // Give the child thresholds so that we return here as soon as
+      // another child becomes more proving or this node's threshold is
+      // exceeded.
+      uint32 cthpn, cthdn;
+      second = min (second, INFINITE);
+      if (attacker)
+        {
+          cthpn = min (thpn, sum (second, 1, INFINITE));
+          cthdn = thdn >= INFINITE ?
+            INFINITE : sum (thdn - dn, best_dn, INFINITE);
+        }
+      else
+        {
+          cthdn = min (thdn, sum (second, 1, INFINITE));
+          cthpn = thpn >= INFINITE ?
+            INFINITE : sum (thpn - pn, best_pn, INFINITE);
+        }
+
+      uint32 cpn, cdn;
+      mid (boards[best_i], rem - 1, !attacker, cthpn, cthdn, cpn, cdn);
+    }
+
+  store (b, rem, pn, dn);
+}
+
+// Follow proven moves from a proven position to build a mating line.
+// If an entry needed has been overwritten the position is proven again.
+void
+Mate_Solver :: extract_pv
+(const Board &b, int rem, bool attacker, Move_Vector &pv) {
+  Move_Vector moves;
+  vector <Board> boards;
+  children (b, attacker, moves, boards);
+
+  if (moves.count == 0 || rem <= 0)
+    return;
+
+  for (int tries = 0; tries < 2; tries++)
+    {
+      // Play any proven move. Every reply by the defender is proven.
+      int pick = -1;
+      for (int i = 0; i < moves.count && pick < 0; i++)
+        {
+          uint32 pn, dn;
+          if (lookup (boards[i], rem - 1, pn, dn) && pn == 0)
+            pick = i;
+        }
+
+      if (pick >= 0)
+        {
+          pv.push (moves[pick]);
+          extract_pv (boards[pick], rem - 1, !attacker, pv);
+          return;
+        }
+
+      uint32 pn, dn;
+      mid (b, rem, attacker, INFINITE, INFINITE, pn, dn);
+      if (pn != 0)
+        return;
+    }
+}
+
+// Search for a mate by the side to move in at most n moves, trying
+// each number of moves in turn so that the shortest mate is found.
+Mate_Solver::Result
+Mate_Solver :: solve (const Board &b, int n, int &moves, Move_Vector &pv) {
+  nodes = 0;
+  aborted = false;
+  pv.clear ();
+
+  for (int i = 1; i <= n; i++)
+    {
+      uint32 pn, dn;
+      mid (b, 2 * i - 1, true, INFINITE, INFINITE, pn, dn);
+
+      if (pn == 0)
+        {
+          moves = i;
+          extract_pv (b, 2 * i - 1, true, pv);
+          return MATE_FOUND;
+        }
+
+      if (aborted)
+        return UNKNOWN;
+    }
+
+  return NO_CHECKING_MATE;
+}
+
+/////////////////////////////////////////////////////////////////
+// Search for a mate by checks in the current position. Usage: //
+//                                                             //
+//   mate <n> [nodes <count>]                                  //
+//                                                             //
+// The node limit defaults to ten million.                     //
+/////////////////////////////////////////////////////////////////
+
+bool
+Session::mate (const string_vector &tokens) {
+  if (tokens.size () < 2 || !is_number (tokens[1]))
+    {
+      fprintf (out, "Usage: mate <n> [nodes <count>]\n");
+      return false;
+    }
+
+  int n = to_int (tokens[1]);
+  Mate_Solver solver;
+  solver.max_nodes = 10 * 1000 * 1000;
+  if (tokens.size () > 3 && tokens[2] == "nodes")
+    solver.max_nodes = atoll (tokens[3].c_str ());
+
+  Move_Vector pv;
+  int moves = 0;
+  uint64 start = mclock ();
+  Mate_Solver::Result r = solver.solve (board, n, moves, pv);
+  double elapsed = (mclock () - start) / 1000.0;
+
+  if (r == Mate_Solver::MATE_FOUND)
+    {
+      Board b = board;
+      fprintf (out, "mate in %i:", moves);
+      for (int i = 0; i < pv.count; i++)
+        {
+          fprintf (out, " %s", b.to_san (pv[i]).c_str ());
+          b.apply (pv[i]);
+        }
+      fprintf (out, "\n");
+    }
+  else if (r == Mate_Solver::NO_CHECKING_MATE)
+    {
+      fprintf (out, "no checking mate in %i\n", n);
+    }
+  else
+    {
+      fprintf (out, "unknown: node limit reached\n");
+    }
+
+  fprintf (out, "%llu nodes in %.2f seconds\n",
+           (unsigned long long) solver.nodes, elapsed);
+
+  return true;
+}
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// mate.hpp                                                                   //
+//                                                                            //
+// A mate solver using depth-first proof-number search. Only checks are       //
+// considered for the attacker and the defender must answer each one, so     //
+// the tree is much narrower than the one searched by alpha-beta.             //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MATE_
+#define _MATE_
+
+#include <vector>
+
+#include "board.hpp"
+#include "move.hpp"
+
+struct Mate_Solver {
+
+  // Outcomes of a search. Since the attacker only plays checks,
+  // NO_CHECKING_MATE does not rule out a mate beginning with a quiet
+  // move.
+  enum Result { MATE_FOUND, NO_CHECKING_MATE, UNKNOWN };
+
+  // Create a solver with a transposition table of size entries, each
+  // 16 bytes long.
+  Mate_Solver (size_t size = 1024 * 1024);
+
+  ~Mate_Solver ();
+
+  // Search for a mate by checks by the side to move in at most n
+  // moves. If one
+  // is found, moves is set to the length of the shortest and pv to a
+  // mating line. Returns UNKNOWN if the node limit was reached.
+  Result solve (const Board &b, int n, int &moves, Move_Vector &pv);
+
+  // Clear the transposition table.
+  void clear ();
+
+  // Node limit, or a negative number if there is none.
+  int64 max_nodes;
+
+  // Statistics.
+  uint64 nodes;
+
+private:
+
+  // Proof and disproof numbers at least this large are infinite.
+  static const uint32 INFINITE = 100000000;
+
+  // An entry in the transposition table. The key combines the hash of
+  // a position with the number of plies remaining, since whether a
+  // mate can be proven depends on both.
+  struct Entry {
+    hash_t key;
+    uint32 pn;  // Proof number: cost of proving a mate.
+    uint32 dn;  // Disproof number: cost of refuting a mate.
+  };
+
+  // Return the key for a position with rem plies remaining.
+  static hash_t key (const Board &b, int rem);
+
+  // Look up a position, returning false if it is not in the table.
+  bool lookup (const Board &b, int rem, uint32 &pn, uint32 &dn) const;
+
+  // Store the proof and disproof numbers for a position.
+  void store (const Board &b, int rem, uint32 pn, uint32 dn);
+
+  // Generate the legal children of a position: checks if the attacker
+  // is to move, otherwise every legal move.
+  void children (const Board &b, bool attacker, Move_Vector &moves,
+                 std::vector <Board> &boards) const;
+
+  // Fetch a child's proof and disproof numbers. Repetitions are not
+  // scored as draws: the plies remaining already bound the search, and
+  // a result which depended on the path could not be stored by
+  // position.
+  void child_numbers (const Board &c, int rem, uint32 &pn, uint32 &dn) const;
+
+  // The multiple iterative deepening step of df-pn. Expand b until its
+  // proof or disproof number reaches a threshold.
+  void mid (const Board &b, int rem, bool attacker,
+            uint32 thpn, uint32 thdn, uint32 &pn, uint32 &dn);
+
+  // Follow proven moves from a proven position to build a mating line.
+  void extract_pv (const Board &b, int rem, bool attacker, Move_Vector &pv);
+
+  // Data.
+  Entry *table;
+  size_t size;
+  bool aborted;
+
+  // Solvers own their storage and are not copied.
+  Mate_Solver (const Mate_Solver &);
+  Mate_Solver &operator= (const Mate_Solver &);
+};
+
+#endif // _MATE_
@@ -180,6 +180,9 @@ struct Move_Vector {
       Move (from, to, color, kind, capture, promote, en_passant);
   }
 
+  // Return true if m is in this list.
+  inline bool contains (const Move &m) const;
+
   // Access elements with the [] operator.
   Move &operator[] (uint8 i) {
     assert (i < count);
@@ -58,6 +58,19 @@ Board::from_calg (const string &s) const {
   return Move (from, to, to_move (), kind, capture, promote, en_passant);
 }
 
+// Find the legal move written as s, or return NULL_MOVE.
+Move
+Board::legal_from_calg (const string &s) const {
+  Move_Vector moves (*this);
+  for (int i = 0; i < moves.count; i++)
+    {
+      Board c = *this;
+      if (to_calg (moves[i]) == s && c.apply (moves[i]))
+        return moves[i];
+    }
+  return NULL_MOVE;
+}
+
 /////////////////////////////////////////////////////////////////////
 // Return a description of a Move in Coordinate Algebraic Notation //
 /////////////////////////////////////////////////////////////////////
@@ -388,15 +401,10 @@ Board::from_san (const string &s) const {
   Move_Vector moves (*this);
   for (int i = 0; i < moves.count; i++)
     {
-      // Only test legal moves.
-      Board c = *this;
-      if (!c.apply (moves[i]))
-        {
-          continue;
-        }
-
-      // Test whether this move is a candidate for the parsed move.
-      if (k == moves[i].get_kind () && to == moves[i].to)
+      // Test whether this move is a candidate for the parsed move,
+      // and only then whether it is legal, which is more expensive.
+      if (k == moves[i].get_kind () && to == moves[i].to &&
+          is_legal (moves[i]))
         {
           if (dis_file == -1 && dis_rank == -1)
             m = moves[i];
@@ -438,11 +446,12 @@ Board::from_san_fail (const string &s) const {
 }
 
 // Construct a board object from a Forsyth-Edwards Notation position
-// string. Note that only the first six tokens in toks are
-// examined. If EPD is true then we are parsing an EPD command and the
-// last two fields, clock and half clock, are not expected.
+// string. Note that only the first six fields are examined and that
+// trailing fields may be omitted. If EPD is true then we are parsing
+// an EPD command and the last two fields, clock and half clock, are
+// not expected.
 Board
-Board::from_fen (const string_vector &toks, bool EPD) {
+Board::from_fen (String_View fen, bool EPD) {
 
   ///////////////////////////////////////////////////////////////////////
   // Forsyth-Edwards Notation:                                         //
@@ -456,6 +465,8 @@ Board::from_fen (const string_vector &toks, bool EPD) {
 
   Board b;
   Board::common_init(b);
+  String_View field;
+  const char *i;
 
   // A FEN record contains six fields. The separator between fields is a
   // space. The fields are:
@@ -470,28 +481,45 @@ Board::from_fen (const string_vector &toks, bool EPD) {
   // designated using upper-case letters ("PNBRQK") while Black take
   // lowercase ("pnbrqk"). Blank squares are noted using digits 1
   // through 8 (the number of blank squares), and "/" separate ranks.
-  if (toks.size () < 1) return b;
+  if ((field = next_token (fen)).empty ()) return b;
 
   int row = 7, file = 0;
-  string::const_iterator i;
-  for (i = toks[0].begin (); i < toks[0].end (); i++)
+  for (i = field.begin (); i < field.end (); i++)
     {
       // Handle a piece code.
-      if (isalpha (*i)) {
-        b.set_piece
-          (to_kind (*i), isupper (*i) ? WHITE : BLACK, row, file++);
-      }
+      if (isalpha (*i))
+        {
+          if (file > 7)
+            throw string ("Bad FEN: too many squares in a rank");
+          b.set_piece
+            (to_kind (*i), isupper (*i) ? WHITE : BLACK, row, file++);
+        }
 
       // Handle count of empty squares.
-      if (isdigit (*i)) { file += atoi (*i); }
+      else if (isdigit (*i))
+        {
+          file += *i - '0';
+          if (file > 8)
+            throw string ("Bad FEN: too many squares in a rank");
+        }
 
       // Handle end of row.
-      if (*i == '/') { row--; file = 0;}
+      else if (*i == '/')
+        {
+          if (--row < 0)
+            throw string ("Bad FEN: too many ranks");
+          file = 0;
+        }
+
+      else
+        {
+          throw string ("Bad FEN: unexpected character in placement");
+        }
     }
 
   // 2. Active color. "w" means white moves next, "b" means black.
-  if (toks.size () < 2) return b;
-  b.set_color (tolower (toks[1][0]) == 'w' ? WHITE : BLACK);
+  if ((field = next_token (fen)).empty ()) return b;
+  b.set_color (tolower (field[0]) == 'w' ? WHITE : BLACK);
 
   // 3. Castling availability. If neither side can castle, this is
   // "-". Otherwise, this has one or more letters: "K" (White can
@@ -502,9 +530,9 @@ Board::from_fen (const string_vector &toks, bool EPD) {
   b.set_castling_right (B_QUEEN_SIDE, false);
   b.set_castling_right (B_KING_SIDE, false);
 
-  if (toks.size () < 3) return b;
+  if ((field = next_token (fen)).empty ()) return b;
 
-  for (i = toks[2].begin (); i < toks[2].end (); i++)
+  for (i = field.begin (); i < field.end (); i++)
     {
       switch (*i)
         {
@@ -518,46 +546,43 @@ Board::from_fen (const string_vector &toks, bool EPD) {
   // 4. En passant target square in algebraic notation. If there's no
   // en passant target square, this is "-". If a pawn has just made a
   // 2-square move, this is the position "behind" the pawn.
-  if (toks.size () < 4)
+  if ((field = next_token (fen)).empty ())
     {
       b.set_en_passant (0);
     }
-  else
+  else if (field[0] != '-')
     {
-      if (toks[3][0] != '-')
-        b.set_en_passant
-          ((toks[3][0] - 'a') + 8 * ((toks[3][1] - '0') - 1));
+      if (field.size () < 2 ||
+          field[0] < 'a' || field[0] > 'h' ||
+          field[1] < '1' || field[1] > '8')
+        throw string ("Bad FEN: bad en passant square");
+      b.set_en_passant ((field[0] - 'a') + 8 * (field[1] - '1'));
     }
 
   // These fields are not expected when we are parsing an EPD command.
   if (!EPD)
     {
+      uint64 n;
 
       // 5. Half move clock: This is the number of half moves since
       // the last pawn advance or capture. This is used to determine
       // if a draw can be claimed under the fifty-move rule.
-      if (toks.size () < 5) {
-        b.half_move_clock = 0;
-      } else {
-        if (is_number (toks[4])) b.half_move_clock = to_int (toks[4]);
-      }
+      field = next_token (fen);
+      b.half_move_clock = parse_uint (field, n) ? n : 0;
 
       // 6. Full move number: The number of the full move. It starts
       // at 1 and is incremented after Black's move.
-      if (toks.size () < 6) {
-        b.full_move_clock = 0;
-      } else {
-        if (is_number (toks[5])) b.full_move_clock = to_int (toks[5]);
-      }
+      field = next_token (fen);
+      b.full_move_clock = parse_uint (field, n) ? n : 0;
     }
 
   return b;
 }
 
-// Construct from FEN string.
+// Construct from a vector of FEN fields.
 Board
-Board::from_fen (const string &fen, bool EPD) {
-  return from_fen (tokenize (fen), EPD);
+Board::from_fen (const string_vector &toks, bool EPD) {
+  return from_fen (join (toks, " "), EPD);
 }
 
 // Return a FEN string for this position.
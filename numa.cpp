@@ -0,0 +1,393 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// numa.cpp                                                                   //
+//                                                                            //
+// NUMA placement and thread pinning. Policies are applied with the mbind     //
+// and sched_setaffinity system calls directly, so there is no dependency    //
+// on libnuma. The topology is read from /sys/devices/system/node.           //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "chesley.hpp"
+
+using namespace std;
+
+// Memory policies understood by mbind.
+static const int MPOL_PREFERRED_ = 1;
+static const int MPOL_INTERLEAVE_ = 3;
+
+Numa_Policy numa_policy = NUMA_DEFAULT;
+Numa_Pin numa_pin = PIN_NONE;
+
+bool
+parse_numa_policy (const string &s, Numa_Policy &p) {
+  if (s == "default")
+    p = NUMA_DEFAULT;
+  else if (s == "interleave")
+    p = NUMA_INTERLEAVE;
+  else if (s == "local")
+    p = NUMA_LOCAL;
+  else
+    return false;
+  return true;
+}
+
+bool
+parse_numa_pin (const string &s, Numa_Pin &p) {
+  if (s == "none")
+    p = PIN_NONE;
+  else if (s == "core")
+    p = PIN_CORE;
+  else if (s == "node")
+    p = PIN_NODE;
+  else
+    return false;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+// Topology                                                           //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+// Parse a kernel cpu list such as "0-3,8-11".
+static void
+parse_cpu_list (const char *s, vector <int> &cpus) {
+  while (*s)
+    {
+      char *end;
+      int lo = strtol (s, &end, 10);
+      if (end == s)
+        break;
+      int hi = lo;
+      s = end;
+      if (*s == '-')
+        {
+          hi = strtol (s + 1, &end, 10);
+          s = end;
+        }
+      for (int i = lo; i <= hi; i++)
+        cpus.push_back (i);
+      while (*s == ',' || *s == '\n' || *s == ' ')
+        s++;
+    }
+}
+
+// Read the cores of each node. A machine without the sysfs files is
+// treated as one node holding every core.
+static vector <vector <int> >
+read_topology () {
+  vector <vector <int> > nodes;
+
+  for (int n = 0; ; n++)
+    {
+      char path[64];
+      snprintf (path, sizeof (path),
+                "/sys/devices/system/node/node%i/cpulist", n);
+      FILE *f = fopen (path, "r");
+      if (!f)
+        break;
+      char buf[1024] = "";
+      if (!fgets (buf, sizeof (buf), f))
+        buf[0] = 0;
+      fclose (f);
+      vector <int> cpus;
+      parse_cpu_list (buf, cpus);
+      nodes.push_back (cpus);
+    }
+
+  if (nodes.empty ())
+    {
+      vector <int> cpus;
+      int n = max ((int) thread::hardware_concurrency (), 1);
+      for (int i = 0; i < n; i++)
+        cpus.push_back (i);
+      nodes.push_back (cpus);
+    }
+
+  return nodes;
+}
+
+// The topology, read once. Worker threads may race to be first here,
+// which the initialization of a local static makes safe.
+static const vector <vector <int> > &
+topology () {
+  static const vector <vector <int> > nodes = read_topology ();
+  return nodes;
+}
+
+int
+numa_node_count () {
+  return topology ().size ();
+}
+
+const vector <int> &
+numa_node_cpus (int node) {
+  return topology ()[node];
+}
+
+// The node of the core the calling thread is running on.
+static int
+current_node () {
+#ifdef __linux__
+  unsigned cpu, node;
+  if (syscall (SYS_getcpu, &cpu, &node, NULL) == 0)
+    return node;
+#endif
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+// Memory placement                                                   //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+void
+numa_place (void *p, size_t bytes) {
+#ifdef __linux__
+  int nodes = numa_node_count ();
+  if (numa_policy == NUMA_DEFAULT || nodes < 2)
+    return;
+
+  unsigned long mask[16];
+  memset (mask, 0, sizeof (mask));
+  int bits = 8 * sizeof (mask);
+
+  int mode;
+  if (numa_policy == NUMA_INTERLEAVE)
+    {
+      mode = MPOL_INTERLEAVE_;
+      for (int n = 0; n < nodes && n < bits; n++)
+        mask[n / 64] |= 1UL << (n % 64);
+    }
+  else
+    {
+      mode = MPOL_PREFERRED_;
+      int n = current_node ();
+      if (n >= bits)
+        return;
+      mask[n / 64] |= 1UL << (n % 64);
+    }
+
+  // A failure leaves the default policy in place, which is always
+  // correct if slower.
+  syscall (SYS_mbind, p, bytes, mode, mask, bits + 1, 0);
+#else
+  (void) p;
+  (void) bytes;
+#endif
+}
+
+// Tables are mapped directly rather than taken from the heap so that a
+// policy covers whole pages belonging to that table alone. Fresh
+// mappings are zero filled and no page is touched until it is used.
+// Returns NULL on failure, as calloc does.
+void *
+numa_alloc (size_t bytes) {
+  if (bytes == 0)
+    bytes = 1;
+  void *p = mmap (NULL, bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  numa_place (p, bytes);
+  return p;
+}
+
+void
+numa_free (void *p, size_t bytes) {
+  if (p)
+    munmap (p, bytes == 0 ? 1 : bytes);
+}
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+// Thread pinning                                                     //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+int
+numa_pin_thread (int index) {
+#ifdef __linux__
+  if (numa_pin == PIN_NONE)
+    return -1;
+
+  const vector <vector <int> > &nodes = topology ();
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  int node;
+
+  if (numa_pin == PIN_CORE)
+    {
+      // Count through the cores of node 0, then node 1, and so on.
+      int total = 0;
+      for (size_t n = 0; n < nodes.size (); n++)
+        total += nodes[n].size ();
+      int i = index % max (total, 1);
+      for (node = 0; i >= (int) nodes[node].size (); node++)
+        i -= nodes[node].size ();
+      CPU_SET (nodes[node][i], &set);
+    }
+  else
+    {
+      node = index % nodes.size ();
+      for (size_t i = 0; i < nodes[node].size (); i++)
+        CPU_SET (nodes[node][i], &set);
+    }
+
+  if (sched_setaffinity (0, sizeof (set), &set) != 0)
+    return -1;
+  return node;
+#else
+  (void) index;
+  return -1;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+// numabench                                                          //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+// One benchmark thread's work and its result.
+struct Bench_Thread {
+  int index;
+  int depth;
+  Board board;
+  uint64 nodes;
+};
+
+// Body of a benchmark thread. The engine, and so its tables, is made
+// after pinning so that a local policy places them on this thread's
+// node.
+static void
+bench_thread (Bench_Thread *t) {
+  numa_pin_thread (t -> index);
+
+  Search_Engine *se = new Search_Engine ();
+  se -> session_poll = false;
+  se -> post = false;
+  se -> controls.mode = UNLIMITED;
+  se -> set_fixed_depth (t -> depth);
+
+  Move_Vector pv;
+  se -> compute_pv (t -> board, MAX_DEPTH, pv);
+  t -> nodes = se -> node_count ();
+
+  delete se;
+}
+
+// Search the position in n threads at once, returning nodes per second
+// in total.
+static double
+bench_threads (const Board &b, int depth, int n) {
+  vector <Bench_Thread> work (n);
+  vector <thread> threads;
+
+  uint64 start = mclock ();
+  for (int i = 0; i < n; i++)
+    {
+      work[i].index = i;
+      work[i].depth = depth;
+      work[i].board = b;
+      work[i].nodes = 0;
+      threads.push_back (thread (bench_thread, &work[i]));
+    }
+
+  uint64 nodes = 0;
+  for (int i = 0; i < n; i++)
+    {
+      threads[i].join ();
+      nodes += work[i].nodes;
+    }
+
+  double elapsed = max ((mclock () - start) / 1000.0, 0.001);
+  return nodes / elapsed;
+}
+
+int
+numabench_main (int argc, char **argv) {
+  string fen =
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 1";
+  int depth = 9;
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      if (arg == "--depth" && i + 1 < argc)
+        {
+          depth = atoi (argv[++i]);
+        }
+      else if (arg == "--fen" && i + 1 < argc)
+        {
+          fen = argv[++i];
+        }
+      else if (arg == "--numa" && i + 1 < argc &&
+               parse_numa_policy (argv[i + 1], numa_policy))
+        {
+          i++;
+        }
+      else if (arg == "--pin" && i + 1 < argc &&
+               parse_numa_pin (argv[i + 1], numa_pin))
+        {
+          i++;
+        }
+      else
+        {
+          fprintf (stderr, "usage: %s numabench [--depth D] [--fen FEN] "
+                   "[--numa default|interleave|local] "
+                   "[--pin none|core|node]\n", arg0);
+          return 1;
+        }
+    }
+
+  Board b = Board::from_fen (fen);
+
+  // Run one thread, then fill each node in turn.
+  int nodes = numa_node_count ();
+  vector <int> counts (1, 1);
+  int cores = 0;
+  for (int n = 0; n < nodes; n++)
+    {
+      cores += numa_node_cpus (n).size ();
+      if (cores > counts.back ())
+        counts.push_back (cores);
+    }
+
+  printf ("%i node(s), %i core(s)\n", nodes, cores);
+  printf ("%8s %14s %14s %8s\n", "threads", "nps", "nps/thread", "speedup");
+
+  double base = 0;
+  for (size_t i = 0; i < counts.size (); i++)
+    {
+      double nps = bench_threads (b, depth, counts[i]);
+      if (i == 0)
+        base = nps;
+      printf ("%8i %14.0f %14.0f %8.2f\n", counts[i], nps,
+              nps / counts[i], base > 0 ? nps / base : 0.0);
+    }
+
+  return 0;
+}
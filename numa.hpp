@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// numa.hpp                                                                   //
+//                                                                            //
+// Placement of large tables across the memory nodes of a NUMA machine and    //
+// pinning of worker threads to cores. On machines with a single node, or    //
+// other than Linux, every function here is a harmless no-op.                 //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _NUMA_
+#define _NUMA_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// How memory for hash tables is placed.
+enum Numa_Policy {
+  NUMA_DEFAULT,     // Wherever the kernel first touches it.
+  NUMA_INTERLEAVE,  // Spread page by page over every node.
+  NUMA_LOCAL        // On the node of the allocating thread.
+};
+
+// How worker threads are pinned.
+enum Numa_Pin {
+  PIN_NONE,         // Not at all.
+  PIN_CORE,         // Each to one core, filling one node before the next.
+  PIN_NODE          // Each to every core of a node, round robin.
+};
+
+// The current configuration, which applies to tables and threads
+// created after it is set.
+extern Numa_Policy numa_policy;
+extern Numa_Pin numa_pin;
+
+// Parse a policy or pinning mode by name, returning false if it is
+// not recognized.
+bool parse_numa_policy (const std::string &s, Numa_Policy &p);
+bool parse_numa_pin (const std::string &s, Numa_Pin &p);
+
+// The number of memory nodes and the cores belonging to each.
+int numa_node_count ();
+const std::vector <int> &numa_node_cpus (int node);
+
+// Allocate zero filled memory placed according to numa_policy, or
+// return NULL, and release it.
+void *numa_alloc (size_t bytes);
+void numa_free (void *p, size_t bytes);
+
+// Apply numa_policy to memory which is already mapped.
+void numa_place (void *p, size_t bytes);
+
+// Pin the calling thread, the index'th worker, according to numa_pin.
+// Returns the node it was pinned to, or -1.
+int numa_pin_thread (int index);
+
+// Entry point for "chesley numabench". Searches a position in an
+// increasing number of threads, one node's worth of cores at a time,
+// and reports nodes per second for each.
+int numabench_main (int argc, char **argv);
+
+#endif // _NUMA_
@@ -35,10 +35,17 @@ PGN :: open (const char *filename) {
   if (!fp) status = FATAL_ERROR;
 }
 
+// Open a stream over len bytes of text in memory.
+void
+PGN :: open (const char *buf, size_t len) {
+  fp = len > 0 ? fmemopen ((void *) buf, len, "r") : NULL;
+  if (!fp) status = FATAL_ERROR;
+}
+
 // Close the stream.
 void
 PGN :: close () {
-  fclose (fp);
+  if (fp) fclose (fp);
   fp = NULL;
 }
 
@@ -254,6 +261,7 @@ PGN::read_moves (Game &g) {
       // Return on EOF.
       if (c == EOF)
         {
+          b.resync ();
           return;
         }
 
@@ -347,7 +355,7 @@ PGN::read_moves (Game &g) {
       if (san.length () > 0)
         {
           Move m = b.from_san (san);
-          if (!b.apply (m))
+          if (!b.apply <APPLY_NO_HASH> (m))
             {
               throw string ("Got bad move: " + san);
             }
@@ -360,7 +368,12 @@ PGN::read_moves (Game &g) {
 
  EOL:
 
+  // Moves are replayed without maintaining the hash keys, which are
+  // computed once for the final position.
+  b.resync ();
+
   // Set the game outcome.
+  g.finished = eog != "*";
   if (eog == "1-0")
     {
       g.winner = WHITE;
@@ -369,7 +382,7 @@ PGN::read_moves (Game &g) {
     {
       g.winner = BLACK;
     }
-  else if (eog == "1/2-1/2")
+  else if (eog == "1/2-1/2" || eog == "*")
     {
       g.winner = NULL_COLOR;
     }
@@ -22,8 +22,14 @@
 #include "move.hpp"
 
 struct Game {
+  Game () : winner (NULL_COLOR), finished (false) {}
+
   // Either black white or null.
   Color winner;
+
+  // False if the result is unknown ("*"), in which case winner is null
+  // but the game is not a draw.
+  bool finished;
   std::vector <Move> moves;
   std::map <std::string, std::string> metadata;
 };
@@ -35,6 +41,10 @@ struct PGN {
   // Open a stream from a file.
   void open (const char *filename);
 
+  // Open a stream over len bytes of text in memory, which must remain
+  // valid until the stream is closed.
+  void open (const char *buf, size_t len);
+
   // Close the stream.
   void close ();
 
@@ -0,0 +1,416 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// pgnfilter.cpp                                                              //
+//                                                                            //
+// Filter and deduplicate large PGN files. The input is mapped into memory    //
+// and split into chunks of whole games. Worker threads parse the games in    //
+// each chunk with the PGN reader, which replays every move on a board, and   //
+// test them against the filters. The main thread writes the text of the      //
+// games which pass, in input order, dropping duplicates.                     //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chesley.hpp"
+
+using namespace std;
+
+// Filters applied to each game. A negative limit or empty string is
+// not applied.
+struct Filter_Options {
+
+  Filter_Options () :
+    min_elo (-1), min_time (-1), min_plies (-1),
+    min_pieces (-1), max_pieces (-1), dedupe (false) {}
+
+  int    min_elo;      // Both players rated at least this.
+  string result;       // Result tag, e.g. "1-0".
+  string eco;          // ECO code prefix, or a range like "B20-B99".
+  string time_control; // TimeControl tag.
+  int    min_time;     // Estimated seconds per player, base + 40 * inc.
+  int    min_plies;    // Minimum game length in half moves.
+  int    min_pieces;   // Pieces, including kings, in the final position.
+  int    max_pieces;
+  bool   dedupe;       // Drop games repeating an earlier game.
+};
+
+// A game which passed the filters.
+struct Kept_Game {
+  String_View text;     // The game as it appears in the input.
+  hash_t      position; // Hash of the final position.
+  uint64      moves;    // Hash of the move sequence.
+};
+
+// The games kept from one chunk of input.
+struct Chunk {
+  String_View       text;
+  vector <Kept_Game> kept;
+  uint64            games;
+  bool              done;
+};
+
+// Return the value of a tag, or the empty string.
+static string
+tag (const Game &g, const char *key) {
+  map <string, string>::const_iterator i = g.metadata.find (key);
+  return i == g.metadata.end () ? "" : i -> second;
+}
+
+// Return a player's rating, or -1 if it is not known.
+static int
+rating (const Game &g, const char *key) {
+  string s = tag (g, key);
+  return is_number (s) ? to_int (s) : -1;
+}
+
+// Estimate the seconds each player has from a "base+increment" time
+// control, or return -1 if there is none.
+static int
+estimated_time (const string &tc) {
+  if (tc.empty () || !isdigit (tc[0]))
+    return -1;
+  int base = atoi (tc.c_str ());
+  size_t plus = tc.find ('+');
+  int inc = plus == string::npos ? 0 : atoi (tc.c_str () + plus + 1);
+  return base + 40 * inc;
+}
+
+// Return true if an ECO code matches a prefix or an inclusive range.
+static bool
+eco_matches (const string &eco, const string &spec) {
+  size_t dash = spec.find ('-');
+  if (dash == string::npos)
+    return eco.compare (0, spec.length (), spec) == 0;
+  return !eco.empty () &&
+    eco >= spec.substr (0, dash) && eco <= spec.substr (dash + 1);
+}
+
+// Test a game against every filter except deduplication. The board is
+// the final position of the game.
+static bool
+accept (const Filter_Options &opts, const Game &g, const Board &b) {
+  if (opts.min_elo >= 0 &&
+      (rating (g, "WhiteElo") < opts.min_elo ||
+       rating (g, "BlackElo") < opts.min_elo))
+    return false;
+
+  if (!opts.result.empty () && tag (g, "Result") != opts.result)
+    return false;
+
+  if (!opts.eco.empty () && !eco_matches (tag (g, "ECO"), opts.eco))
+    return false;
+
+  if (!opts.time_control.empty () &&
+      tag (g, "TimeControl") != opts.time_control)
+    return false;
+
+  if (opts.min_time >= 0 &&
+      estimated_time (tag (g, "TimeControl")) < opts.min_time)
+    return false;
+
+  if (opts.min_plies >= 0 && (int) g.moves.size () < opts.min_plies)
+    return false;
+
+  int pieces = pop_count (b.occupied);
+  if (opts.min_pieces >= 0 && pieces < opts.min_pieces)
+    return false;
+  if (opts.max_pieces >= 0 && pieces > opts.max_pieces)
+    return false;
+
+  return true;
+}
+
+// Hash a sequence of moves.
+static uint64
+hash_moves (const vector <Move> &moves) {
+  uint64 h = 14695981039346656037ULL;
+  for (size_t i = 0; i < moves.size (); i++)
+    {
+      h = (h ^ moves[i].from) * 1099511628211ULL;
+      h = (h ^ moves[i].to) * 1099511628211ULL;
+      h = (h ^ moves[i].promote) * 1099511628211ULL;
+    }
+  return h;
+}
+
+// Return the offset of the first game to start at or after offset i,
+// or the length of the text if there is none. A game starts with a
+// tag at the beginning of a line which does not follow another tag.
+static size_t
+next_game (String_View text, size_t i) {
+  while (i < text.size ())
+    {
+      // Find the start of the next line.
+      while (i < text.size () && text[i] != '\n')
+        i++;
+      if (i++ >= text.size ())
+        break;
+      if (i >= text.size () || text[i] != '[')
+        continue;
+
+      // Look back past blank lines to the previous line.
+      size_t j = i - 1;
+      while (j > 0 && isspace (text[j - 1]))
+        j--;
+      size_t line = j;
+      while (line > 0 && text[line - 1] != '\n')
+        line--;
+      if (j == 0 || text[line] != '[')
+        return i;
+    }
+
+  return text.size ();
+}
+
+// Parse and filter the games in a chunk.
+static void
+filter_chunk (const Filter_Options &opts, Chunk &c) {
+  PGN pgn;
+  pgn.open (c.text.begin (), c.text.size ());
+
+  while (pgn.status != PGN::FATAL_ERROR)
+    {
+      bool recovering = pgn.status == PGN::RECOVERABLE_ERROR;
+      long start = ftell (pgn.fp);
+      Game g = pgn.read_game ();
+      long end = ftell (pgn.fp);
+
+      if (pgn.status == PGN::END_OF_FILE || pgn.status == PGN::FATAL_ERROR)
+        break;
+      if (pgn.status != PGN::OK)
+        continue;
+      c.games++;
+
+      if (!accept (opts, g, pgn.b))
+        continue;
+
+      // Find the text of the game, skipping any debris from a game
+      // which failed to parse.
+      const char *first = c.text.begin () + start;
+      const char *last = c.text.begin () + end;
+      if (recovering)
+        while (first < last && *first != '[')
+          first++;
+      while (first < last && isspace (*first))
+        first++;
+      while (last > first && isspace (last[-1]))
+        last--;
+
+      Kept_Game k;
+      k.text = String_View (first, last - first);
+      k.position = pgn.b.hash;
+      k.moves = hash_moves (g.moves);
+      c.kept.push_back (k);
+    }
+
+  pgn.close ();
+}
+
+// State shared between the worker threads and the writer.
+struct Filter_State {
+
+  Filter_State (const Filter_Options &opts, vector <Chunk> &chunks) :
+    opts (opts), chunks (chunks), next (0) {}
+
+  const Filter_Options &opts;
+  vector <Chunk> &chunks;
+
+  // The next chunk to be taken by a worker.
+  atomic <size_t> next;
+
+  // Protects each chunk's done flag.
+  mutex m;
+  condition_variable cv;
+};
+
+// Body of each worker thread.
+static void
+filter_worker (Filter_State *s) {
+  size_t i;
+  while ((i = s -> next++) < s -> chunks.size ())
+    {
+      filter_chunk (s -> opts, s -> chunks[i]);
+      unique_lock <mutex> lock (s -> m);
+      s -> chunks[i].done = true;
+      s -> cv.notify_all ();
+    }
+}
+
+// Entry point for "chesley pgnfilter".
+int
+pgnfilter_main (int argc, char **argv) {
+  Filter_Options opts;
+  string in_name, out_name;
+  int threads = max ((int) thread::hardware_concurrency (), 1);
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      bool has_value = i + 1 < argc;
+
+      if (arg == "--min-elo" && has_value)
+        opts.min_elo = atoi (argv[++i]);
+      else if (arg == "--result" && has_value)
+        opts.result = argv[++i];
+      else if (arg == "--eco" && has_value)
+        opts.eco = argv[++i];
+      else if (arg == "--time-control" && has_value)
+        opts.time_control = argv[++i];
+      else if (arg == "--min-time" && has_value)
+        opts.min_time = atoi (argv[++i]);
+      else if (arg == "--min-plies" && has_value)
+        opts.min_plies = atoi (argv[++i]);
+      else if (arg == "--min-pieces" && has_value)
+        opts.min_pieces = atoi (argv[++i]);
+      else if (arg == "--max-pieces" && has_value)
+        opts.max_pieces = atoi (argv[++i]);
+      else if (arg == "--dedupe")
+        opts.dedupe = true;
+      else if (arg == "--threads" && has_value)
+        threads = max (atoi (argv[++i]), 1);
+      else if (arg == "--out" && has_value)
+        out_name = argv[++i];
+      else if (arg[0] != '-' && in_name.empty ())
+        in_name = arg;
+      else
+        {
+          in_name.clear ();
+          break;
+        }
+    }
+
+  if (in_name.empty ())
+    {
+      fprintf (stderr, "usage: %s pgnfilter [--min-elo N] [--result R] "
+               "[--eco CODE|FROM-TO]\n"
+               "         [--time-control TC] [--min-time SECS] "
+               "[--min-plies N]\n"
+               "         [--min-pieces N] [--max-pieces N] [--dedupe] "
+               "[--threads T]\n"
+               "         [--out FILE] <pgn>\n", arg0);
+      return 1;
+    }
+
+  // Map the input into memory.
+  int fd = open (in_name.c_str (), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) < 0)
+    {
+      fprintf (stderr, "Error: could not open %s\n", in_name.c_str ());
+      return 1;
+    }
+
+  size_t size = st.st_size;
+  const char *data = NULL;
+  if (size > 0)
+    {
+      void *p = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED)
+        {
+          fprintf (stderr, "Error: could not map %s\n", in_name.c_str ());
+          close (fd);
+          return 1;
+        }
+      data = (const char *) p;
+      madvise (p, size, MADV_SEQUENTIAL);
+    }
+
+  FILE *out = stdout;
+  if (!out_name.empty () && !(out = fopen (out_name.c_str (), "w")))
+    {
+      fprintf (stderr, "Error: could not open %s\n", out_name.c_str ());
+      return 1;
+    }
+
+  uint64 start = mclock ();
+
+  // Split the input into chunks of about a megabyte of whole games.
+  const size_t CHUNK_SIZE = 1024 * 1024;
+  String_View text (data, size);
+  vector <Chunk> chunks;
+  for (size_t i = 0; i < size;)
+    {
+      size_t end = next_game (text, min (i + CHUNK_SIZE, size));
+      Chunk c;
+      c.text = String_View (data + i, end - i);
+      c.games = 0;
+      c.done = false;
+      chunks.push_back (c);
+      i = end;
+    }
+
+  // Filter the chunks on worker threads, taking them in order.
+  Filter_State state (opts, chunks);
+  vector <thread> workers;
+  for (int t = 0; t < threads; t++)
+    workers.push_back (thread (filter_worker, &state));
+
+  // Write the kept games as each chunk completes.
+  set <pair <hash_t, uint64> > seen;
+  uint64 games = 0, kept = 0, duplicates = 0;
+
+  for (size_t i = 0; i < chunks.size (); i++)
+    {
+      {
+        unique_lock <mutex> lock (state.m);
+        while (!chunks[i].done)
+          state.cv.wait (lock);
+      }
+
+      Chunk &c = chunks[i];
+      games += c.games;
+      for (size_t j = 0; j < c.kept.size (); j++)
+        {
+          const Kept_Game &k = c.kept[j];
+          if (opts.dedupe &&
+              !seen.insert (make_pair (k.position, k.moves)).second)
+            {
+              duplicates++;
+              continue;
+            }
+          fwrite (k.text.begin (), 1, k.text.size (), out);
+          fputs ("\n\n", out);
+          kept++;
+        }
+      c.kept.clear ();
+    }
+
+  for (size_t t = 0; t < workers.size (); t++)
+    workers[t].join ();
+
+  if (out != stdout)
+    fclose (out);
+  else
+    fflush (out);
+  if (data)
+    munmap ((void *) data, size);
+  close (fd);
+
+  // Report throughput.
+  double elapsed = (mclock () - start) / 1000.0;
+  fprintf (stderr, "%llu games read, %llu kept, %llu duplicates in %.2f "
+           "seconds, %.0f games/sec\n",
+           (unsigned long long) games, (unsigned long long) kept,
+           (unsigned long long) duplicates, elapsed,
+           elapsed > 0 ? games / elapsed : 0.0);
+
+  return 0;
+}
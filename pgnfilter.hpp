@@ -0,0 +1,23 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// pgnfilter.hpp                                                              //
+//                                                                            //
+// Filter and deduplicate large PGN files.                                    //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _PGNFILTER_
+#define _PGNFILTER_
+
+// Entry point for "chesley pgnfilter [options] <pgn>". The input is
+// mapped into memory and split into chunks of whole games, which are
+// parsed and filtered by T worker threads. Games passing every filter
+// are written unchanged, in input order, to standard output or to the
+// file given by --out.
+int pgnfilter_main (int argc, char **argv);
+
+#endif // _PGNFILTER_
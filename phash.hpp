@@ -16,13 +16,19 @@
 #include <stdlib.h>
 
 #include "common.hpp"
+#include "numa.hpp"
 
 struct PHash
 {
   // Initialize the table.
   PHash (size_t sz) :
     sz (sz), hits (0), misses (0), writes (0), collisions (0) {
-    table = (Entry *) calloc (sz, sizeof (Entry));
+    table = (Entry *) numa_alloc (sz * sizeof (Entry));
+  }
+
+  // Release the table.
+  ~PHash () {
+    numa_free (table, sz * sizeof (Entry));
   }
 
   // An entry in the hash table.
@@ -70,6 +76,14 @@ struct PHash
     hits = misses = writes = collisions = 0;
   }
 
+private:
+
+  // Tables own their storage and are not copied.
+  PHash (const PHash &);
+  PHash &operator= (const PHash &);
+
+public:
+
   // Data.
   size_t sz;
   Entry *table;
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// pipeline.hpp                                                               //
+//                                                                            //
+// A pool of worker threads, each owning a private search engine, which       //
+// processes a stream of jobs and writes their results in the order the       //
+// jobs were submitted.                                                       //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _PIPELINE_
+#define _PIPELINE_
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search.hpp"
+
+template <typename Job>
+struct Pipeline {
+
+  // Create a pipeline writing results to out. Nothing is run until
+  // start is called.
+  Pipeline (int nthreads, FILE *out) :
+    nthreads (std::max (nthreads, 1)), out (out),
+    jobs_done (0), next_in (0), next_out (0), closing (false) {}
+
+  virtual ~Pipeline () {}
+
+  // Configure a worker's search engine before it processes any jobs.
+  virtual void init_engine (Search_Engine &se IS_UNUSED) {}
+
+  // Process one job, returning the text to write for it.
+  virtual std::string process (Search_Engine &se, const Job &job) = 0;
+
+  // Start the worker threads.
+  void start () {
+    for (int i = 0; i < nthreads; i++)
+      threads.push_back (std::thread (&Pipeline::worker, this, i));
+  }
+
+  // Queue a job, blocking while too many results are outstanding.
+  void push (const Job &job) {
+    std::unique_lock <std::mutex> lock (m);
+    while (next_in - next_out >= max_in_flight ())
+      cv_space.wait (lock);
+    queue.push_back (std::make_pair (next_in++, job));
+    cv_work.notify_one ();
+  }
+
+  // Wait for every queued job to be written and stop the workers.
+  void finish () {
+    {
+      std::unique_lock <std::mutex> lock (m);
+      closing = true;
+      cv_work.notify_all ();
+    }
+    for (size_t i = 0; i < threads.size (); i++)
+      threads[i].join ();
+    threads.clear ();
+  }
+
+  // Configuration.
+  const int nthreads;
+  FILE *out;
+
+  // Statistics.
+  uint64 jobs_done;
+
+private:
+
+  // Allow a bounded number of jobs to be queued or held waiting for
+  // an earlier result, so memory use does not grow with the input.
+  uint64 max_in_flight () const {
+    return 16 * nthreads;
+  }
+
+  // Body of each worker thread. The thread is pinned before its engine
+  // is made so that the engine's tables can be placed on its node.
+  void worker (int index) {
+    numa_pin_thread (index);
+    Search_Engine *se = new Search_Engine ();
+    se -> session_poll = false;
+    se -> post = false;
+    init_engine (*se);
+
+    while (true)
+      {
+        std::pair <uint64, Job> job;
+
+        {
+          std::unique_lock <std::mutex> lock (m);
+          while (queue.empty () && !closing)
+            cv_work.wait (lock);
+          if (queue.empty ())
+            break;
+          job = queue.front ();
+          queue.pop_front ();
+        }
+
+        std::string result = process (*se, job.second);
+        write_in_order (job.first, result);
+      }
+
+    delete se;
+  }
+
+  // Record a result and write every result which is now next in
+  // sequence.
+  void write_in_order (uint64 seq, const std::string &result) {
+    std::unique_lock <std::mutex> lock (m);
+    done[seq] = result;
+
+    typename std::map <uint64, std::string> :: iterator i;
+    while ((i = done.find (next_out)) != done.end ())
+      {
+        fputs (i -> second.c_str (), out);
+        done.erase (i);
+        next_out++;
+        jobs_done++;
+      }
+
+    fflush (out);
+    cv_space.notify_all ();
+  }
+
+  // Shared state, protected by m.
+  std::deque <std::pair <uint64, Job> > queue;
+  std::map <uint64, std::string> done;
+  uint64 next_in;
+  uint64 next_out;
+  bool closing;
+
+  std::mutex m;
+  std::condition_variable cv_work;
+  std::condition_variable cv_space;
+  std::vector <std::thread> threads;
+};
+
+#endif // _PIPELINE_
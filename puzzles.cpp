@@ -0,0 +1,221 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// puzzles.cpp                                                                //
+//                                                                            //
+// Mine tactical puzzles from a PGN file. Each game is replayed and every     //
+// position is given a shallow search, then searched again with the best      //
+// move excluded. A position where the best move is much better than every    //
+// alternative is written as an EPD record giving the move and the line       //
+// which follows. Games are spread over worker threads, each reusing its      //
+// own transposition table from game to game, and written in input order.     //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "chesley.hpp"
+#include "pipeline.hpp"
+
+using namespace std;
+
+struct Puzzle_Miner : public Pipeline <Game> {
+
+  Puzzle_Miner (int nthreads, FILE *out, int depth, int margin) :
+    Pipeline <Game> (nthreads, out), depth (depth), margin (margin),
+    positions (0), puzzles (0) {}
+
+  // Configure a worker's engine for a fixed depth search.
+  void init_engine (Search_Engine &se) {
+    se.controls.mode = UNLIMITED;
+    se.set_fixed_depth (depth);
+  }
+
+  // Mine one game.
+  string process (Search_Engine &se, const Game &g) {
+    try
+      {
+        return mine (se, g);
+      }
+    catch (string e)
+      {
+        fprintf (stderr, "Error mining game: %s\n", e.c_str ());
+        return "";
+      }
+  }
+
+  string mine (Search_Engine &se, const Game &g) {
+    ostringstream s;
+    Board b;
+
+    map <string, string>::const_iterator fen = g.metadata.find ("FEN");
+    if (fen != g.metadata.end ())
+      b = Board::from_fen (fen -> second);
+    else
+      b = Board::startpos ();
+
+    // Name each puzzle after its game.
+    string name;
+    map <string, string>::const_iterator white = g.metadata.find ("White");
+    map <string, string>::const_iterator black = g.metadata.find ("Black");
+    if (white != g.metadata.end () && black != g.metadata.end ())
+      name = white -> second + " - " + black -> second + ", ";
+
+    Search_Engine::Rep_Table history;
+    history[b.hash]++;
+
+    for (size_t i = 0; i < g.moves.size (); i++)
+      {
+        positions++;
+        mine_position (se, b, history, name, i, s);
+
+        if (!b.apply (g.moves[i]))
+          throw string ("illegal move in game");
+        history[b.hash]++;
+      }
+
+    return s.str ();
+  }
+
+  // Search b, then search it again with the best move excluded, and
+  // write it as a puzzle if the best move is at least margin better
+  // than the alternatives, the alternatives do not win anyway and the
+  // best move does not lose anyway.
+  void mine_position (Search_Engine &se, const Board &b,
+                      const Search_Engine::Rep_Table &history,
+                      const string &name, size_t ply, ostringstream &s) {
+    if (b.child_count () < 2)
+      return;
+
+    se.rt = history;
+    if (se.is_triple_rep (b))
+      return;
+
+    Move_Vector pv, alt;
+    Score best = se.compute_pv (b, MAX_DEPTH, pv);
+
+    se.excluded.push (pv[0]);
+    Score second = se.compute_pv (b, MAX_DEPTH, alt);
+    se.excluded.clear ();
+
+    if (best - second < margin || second >= margin || best <= -margin ||
+        (is_mate (second) && second > 0))
+      return;
+
+    puzzles++;
+
+    // Write the position, which is the first four fields of its
+    // FEN string, then the solution.
+    string_vector fields = tokenize (b.to_fen ());
+    fields.resize (4);
+    s << join (fields, " ")
+      << " bm " << b.to_san (pv[0]) << ";"
+      << " ce " << best << ";"
+      << " pv";
+
+    Board c = b;
+    for (int i = 0; i < pv.count; i++)
+      {
+        s << " " << c.to_san (pv[i]);
+        if (!c.apply (pv[i]))
+          break;
+      }
+
+    s << "; id \"" << name << "ply " << ply + 1 << "\";\n";
+  }
+
+  const int depth;
+  const int margin;
+
+  // Statistics.
+  atomic <uint64> positions;
+  atomic <uint64> puzzles;
+};
+
+//////////////////////////////////////////////////////////////////
+// Mine tactical puzzles from a PGN file. Usage:                //
+//                                                              //
+//   puzzles <pgn> [out <file>] [depth <d>] [margin <cp>]       //
+//           [threads <t>]                                      //
+//////////////////////////////////////////////////////////////////
+
+bool
+Session::puzzles (const string_vector &tokens) {
+  string in_name, out_name;
+  int depth = 5;
+  int margin = 200;
+  int threads = max ((int) thread::hardware_concurrency (), 1);
+
+  if (tokens.size () < 2)
+    {
+      fprintf (out, "Usage: puzzles <pgn> [out <file>] [depth <d>] "
+               "[margin <cp>] [threads <t>]\n");
+      return false;
+    }
+
+  in_name = tokens[1];
+  for (size_t i = 2; i + 1 < tokens.size (); i += 2)
+    {
+      if (tokens[i] == "out")
+        out_name = tokens[i + 1];
+      else if (tokens[i] == "depth")
+        depth = to_int (tokens[i + 1]);
+      else if (tokens[i] == "margin")
+        margin = to_int (tokens[i + 1]);
+      else if (tokens[i] == "threads")
+        threads = to_int (tokens[i + 1]);
+    }
+
+  PGN pgn;
+  pgn.open (in_name.c_str ());
+  if (pgn.status == PGN::FATAL_ERROR)
+    {
+      fprintf (out, "Error: could not open %s\n", in_name.c_str ());
+      return false;
+    }
+
+  FILE *fp = out;
+  if (!out_name.empty () && !(fp = fopen (out_name.c_str (), "w")))
+    {
+      fprintf (out, "Error: could not open %s\n", out_name.c_str ());
+      pgn.close ();
+      return false;
+    }
+
+  uint64 start = mclock ();
+  Puzzle_Miner miner (threads, fp, max (depth, 1), max (margin, 1));
+  miner.start ();
+
+  // Queue each game which was read successfully.
+  while (true)
+    {
+      Game g = pgn.read_game ();
+      if (pgn.status == PGN::END_OF_FILE || pgn.status == PGN::FATAL_ERROR)
+        break;
+      if (pgn.status == PGN::OK)
+        miner.push (g);
+    }
+
+  miner.finish ();
+  pgn.close ();
+  if (fp != out)
+    fclose (fp);
+
+  double elapsed = (mclock () - start) / 1000.0;
+  fprintf (out, "Found %llu puzzles in %llu games, %llu positions in "
+           "%.2f seconds, %.0f positions/hour.\n",
+           (unsigned long long) miner.puzzles,
+           (unsigned long long) miner.jobs_done,
+           (unsigned long long) miner.positions, elapsed,
+           elapsed > 0 ? 3600 * miner.positions / elapsed : 0.0);
+
+  return true;
+}
@@ -0,0 +1,422 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// scheduler.cpp                                                              //
+//                                                                            //
+// A scheduler sharing a fixed CPU budget between concurrent search jobs      //
+// with priorities and deadlines.                                             //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include "chesley.hpp"
+
+using namespace std;
+
+// A job as tracked by the scheduler.
+struct Scheduler :: Entry {
+  Entry (const Sched_Job &job) : job (job) {}
+
+  int       id;
+  Sched_Job job;
+  int64     submitted;    // Time of submission.
+  int64     abs_deadline; // Absolute deadline, or -1.
+  bool      started;      // Has a thread been started for this job?
+  bool      granted;      // Does this job currently hold a core?
+};
+
+// Passes a search's iteration boundaries back to the scheduler.
+struct Scheduler :: Observer : public Search_Observer {
+  Observer (Scheduler *s, Entry *e) : s (s), e (e) {}
+
+  bool iteration_done (Search_Engine &se IS_UNUSED, int depth IS_UNUSED) {
+    return s -> yield (e);
+  }
+
+  Scheduler *s;
+  Entry *e;
+};
+
+// Return true if job a should be given a core before job b.
+static bool
+outranks (const Sched_Job &a, int64 a_deadline, int a_id,
+          const Sched_Job &b, int64 b_deadline, int b_id) {
+  if (a.priority != b.priority)
+    return a.priority > b.priority;
+
+  // A job with a deadline goes before one without.
+  if (a_deadline != b_deadline)
+    return b_deadline < 0 || (a_deadline >= 0 && a_deadline < b_deadline);
+
+  return a_id < b_id;
+}
+
+Scheduler :: Scheduler (int cores, int max_queued) :
+  cores (cores > 0 ? cores : max ((int) thread::hardware_concurrency (), 1)),
+  max_queued (max_queued > 0 ? max_queued : 4 * this -> cores),
+  jobs_done (0), total_cpu_time (0),
+  queued (0), running (0), outstanding (0), next_id (1) {}
+
+Scheduler :: ~Scheduler () {
+  finish ();
+  for (size_t i = 0; i < idle_engines.size (); i++)
+    delete idle_engines[i];
+}
+
+// Queue a job, returning its identifier.
+int
+Scheduler :: submit (const Sched_Job &job) {
+  unique_lock <mutex> lock (m);
+  while (queued >= max_queued)
+    cv.wait (lock);
+  reap ();
+
+  // The deadline runs from submission, not from the call.
+  Entry *e = new Entry (job);
+  e -> id = next_id++;
+  e -> submitted = mclock ();
+  e -> abs_deadline = job.deadline >= 0 ? e -> submitted + job.deadline : -1;
+  e -> started = false;
+  e -> granted = false;
+
+  outstanding++;
+  queued++;
+  waiting.push_back (e);
+  dispatch ();
+  return e -> id;
+}
+
+// Wait for every job to complete.
+void
+Scheduler :: finish () {
+  unique_lock <mutex> lock (m);
+  while (outstanding > 0)
+    cv.wait (lock);
+  reap ();
+}
+
+// Join the threads of completed jobs. Each has nothing left to do but
+// return once its identifier is in finished, so joining is brief.
+void
+Scheduler :: reap () {
+  for (size_t i = 0; i < finished.size (); i++)
+    {
+      map <int, thread> :: iterator t = threads.find (finished[i]);
+      t -> second.join ();
+      threads.erase (t);
+    }
+  finished.clear ();
+}
+
+// Return the best waiting job.
+list <Scheduler :: Entry *> :: iterator
+Scheduler :: best_waiting () {
+  list <Entry *> :: iterator best = waiting.begin ();
+  list <Entry *> :: iterator i;
+
+  for (i = waiting.begin (); i != waiting.end (); i++)
+    if (outranks ((*i) -> job, (*i) -> abs_deadline, (*i) -> id,
+                  (*best) -> job, (*best) -> abs_deadline, (*best) -> id))
+      best = i;
+
+  return best;
+}
+
+// Grant free cores to the best waiting jobs, starting a thread for any
+// job which has not yet run.
+void
+Scheduler :: dispatch () {
+  while (running < cores && !waiting.empty ())
+    {
+      list <Entry *> :: iterator i = best_waiting ();
+      Entry *e = *i;
+      waiting.erase (i);
+
+      running++;
+      e -> granted = true;
+      if (!e -> started)
+        {
+          e -> started = true;
+          queued--;
+          threads[e -> id] = thread (&Scheduler::run, this, e);
+        }
+    }
+
+  cv.notify_all ();
+}
+
+// At an iteration boundary, hand this job's core to a waiting job of
+// higher priority if there is one and wait to be granted a core
+// again. Returns false if the job's deadline has passed.
+bool
+Scheduler :: yield (Entry *e) {
+  unique_lock <mutex> lock (m);
+
+  if (e -> abs_deadline >= 0 && (int64) mclock () >= e -> abs_deadline)
+    return false;
+
+  if (waiting.empty () ||
+      (*best_waiting ()) -> job.priority <= e -> job.priority)
+    return true;
+
+  e -> granted = false;
+  e -> job.preemptions++;
+  running--;
+  waiting.push_back (e);
+  dispatch ();
+
+  while (!e -> granted)
+    {
+      if (e -> abs_deadline < 0)
+        {
+          cv.wait (lock);
+          continue;
+        }
+
+      int64 remaining = e -> abs_deadline - (int64) mclock ();
+      if (remaining <= 0)
+        {
+          // Give up our place in line and end the search.
+          waiting.remove (e);
+          return false;
+        }
+
+      cv.wait_for (lock, chrono::milliseconds (remaining));
+    }
+
+  return true;
+}
+
+// Take an engine from the pool or create a new one.
+Search_Engine *
+Scheduler :: take_engine () {
+  if (idle_engines.empty ())
+    {
+      Search_Engine *se = new Search_Engine ();
+      se -> session_poll = false;
+      se -> post = false;
+      return se;
+    }
+
+  Search_Engine *se = idle_engines.back ();
+  idle_engines.pop_back ();
+  return se;
+}
+
+// Body of each job's thread.
+void
+Scheduler :: run (Entry *e) {
+  Sched_Job &job = e -> job;
+  uint64 cpu_start = thread_cpu_time ();
+  Search_Engine *se;
+
+  {
+    unique_lock <mutex> lock (m);
+    se = take_engine ();
+  }
+
+  Observer observer (this, e);
+  se -> observer = &observer;
+  se -> stop = false;
+
+  // Configure limits. The deadline runs from submission, so time
+  // spent waiting for a core counts against it.
+  if (e -> abs_deadline >= 0)
+    {
+      se -> set_fixed_time
+        ((int) max ((int64) 1, e -> abs_deadline - (int64) mclock ()));
+    }
+  else
+    {
+      se -> controls.mode = UNLIMITED;
+      se -> controls.fixed_time = -1;
+    }
+  se -> set_fixed_depth (job.depth);
+  se -> set_fixed_nodes (job.nodes);
+  se -> rt.clear ();
+
+  try
+    {
+      if (!job.board.is_valid ())
+        {
+          job.error = "illegal position";
+        }
+      else if (job.board.child_count () == 0)
+        {
+          // There is nothing to search if the game is over.
+          job.score =
+            job.board.in_check (job.board.to_move ()) ? -MATE_VAL : 0;
+        }
+      else
+        {
+          job.score = se -> compute_pv (job.board, MAX_DEPTH, job.pv);
+          job.depth_reached = se -> stats.depth;
+          job.nodes_searched = se -> node_count ();
+        }
+    }
+  catch (string s)
+    {
+      job.error = s;
+    }
+
+  se -> observer = NULL;
+  job.cpu_time = thread_cpu_time () - cpu_start;
+  job.wall_time = mclock () - e -> submitted;
+
+  {
+    unique_lock <mutex> lock (done_m);
+    job_done (e -> id, job);
+  }
+
+  unique_lock <mutex> lock (m);
+  if (e -> granted)
+    running--;
+  idle_engines.push_back (se);
+  jobs_done++;
+  total_cpu_time += job.cpu_time;
+  outstanding--;
+  finished.push_back (e -> id);
+  delete e;
+  dispatch ();
+}
+
+//////////////////////////////
+// Command line entry point //
+//////////////////////////////
+
+// Write one line for each completed job.
+struct Schedule : public Scheduler {
+
+  Schedule (int cores) : Scheduler (cores) {}
+
+  // Write a line of the form:
+  //
+  //  job <id> priority <p> move <calg> score <cp> depth <ply> nodes <n>
+  //  cpu <ms> wall <ms> preempted <k> pv <calg> ...
+  //
+  // or "job <id> error <message>".
+  void job_done (int id, const Sched_Job &job) {
+    ostringstream s;
+
+    s << "job " << id;
+    if (!job.error.empty ())
+      {
+        s << " error " << job.error;
+      }
+    else
+      {
+        s << " priority " << job.priority
+          << " move "
+          << (job.pv.count > 0 ? job.board.to_calg (job.pv[0]) : "none")
+          << " score " << job.score
+          << " depth " << job.depth_reached
+          << " nodes " << job.nodes_searched
+          << " cpu " << job.cpu_time
+          << " wall " << job.wall_time
+          << " preempted " << job.preemptions
+          << " pv";
+        for (int i = 0; i < job.pv.count; i++)
+          s << " " << job.board.to_calg (job.pv[i]);
+      }
+
+    fprintf (stdout, "%s\n", s.str ().c_str ());
+    fflush (stdout);
+  }
+};
+
+// Entry point for "chesley schedule".
+int
+schedule_main (int argc, char **argv) {
+  int cores = 0;
+  int64 nodes = -1;
+  int depth = -1;
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      if (arg == "--cores" && i + 1 < argc)
+        {
+          cores = atoi (argv[++i]);
+        }
+      else if (arg == "--nodes" && i + 1 < argc)
+        {
+          nodes = atoll (argv[++i]);
+        }
+      else if (arg == "--depth" && i + 1 < argc)
+        {
+          depth = atoi (argv[++i]);
+        }
+      else
+        {
+          fprintf (stderr, "usage: %s schedule [--cores N] [--depth D] "
+                   "[--nodes N]\n", arg0);
+          return 1;
+        }
+    }
+
+  uint64 start = mclock ();
+  Schedule scheduler (cores);
+
+  // Submit each non-blank line of input as it arrives.
+  while (char *line = get_line (stdin))
+    {
+      string_vector tokens = tokenize (line);
+      free (line);
+      if (tokens.size () == 0)
+        continue;
+
+      Sched_Job job;
+      job.depth = depth;
+      job.nodes = nodes;
+
+      size_t i = 0;
+      for (; i + 1 < tokens.size (); i += 2)
+        {
+          if (tokens[i] == "priority")
+            job.priority = to_int (tokens[i + 1]);
+          else if (tokens[i] == "deadline")
+            job.deadline = to_int (tokens[i + 1]);
+          else if (tokens[i] == "depth")
+            job.depth = to_int (tokens[i + 1]);
+          else if (tokens[i] == "nodes")
+            job.nodes = atoll (tokens[i + 1].c_str ());
+          else
+            break;
+        }
+
+      // Without a limit the search would run forever.
+      if (job.depth <= 0 && job.nodes <= 0 && job.deadline < 0)
+        job.depth = 6;
+
+      try
+        {
+          job.board = Board::from_fen (slice (tokens, i));
+        }
+      catch (string e)
+        {
+          fprintf (stdout, "error %s\n", e.c_str ());
+          continue;
+        }
+
+      scheduler.submit (job);
+    }
+
+  scheduler.finish ();
+
+  // Report CPU use against the budget.
+  double elapsed = (mclock () - start) / 1000.0;
+  fprintf (stderr, "%llu jobs on %i cores in %.2f seconds, "
+           "%.2f cpu seconds\n",
+           (unsigned long long) scheduler.jobs_done, scheduler.cores,
+           elapsed, scheduler.total_cpu_time / 1000.0);
+
+  return 0;
+}
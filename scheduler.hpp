@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// scheduler.hpp                                                              //
+//                                                                            //
+// A scheduler sharing a fixed CPU budget between concurrent search jobs      //
+// with priorities and deadlines.                                             //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SCHEDULER_
+#define _SCHEDULER_
+
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search.hpp"
+
+// A search job and, once it has run, its results.
+struct Sched_Job {
+
+  Sched_Job () :
+    priority (0), deadline (-1), depth (-1), nodes (-1),
+    score (0), depth_reached (0), nodes_searched (0),
+    cpu_time (0), wall_time (0), preemptions (0) {}
+
+  // Request.
+  Board board;
+  int   priority;         // Jobs with higher priorities run first.
+  int64 deadline;         // Milliseconds after submission, or -1.
+  int   depth;            // Depth limit, or -1.
+  int64 nodes;            // Node limit, or -1.
+
+  // Results.
+  Score       score;
+  Move_Vector pv;
+  int         depth_reached;
+  uint64      nodes_searched;
+  uint64      cpu_time;    // CPU milliseconds spent searching.
+  uint64      wall_time;   // Milliseconds from submission to completion.
+  int         preemptions; // Times suspended for a higher priority job.
+  std::string error;
+};
+
+// Each job is granted one core at a time, as a search engine is single
+// threaded. Jobs are started in order of priority, then deadline, then
+// submission. A running job is preempted at the end of an iteration if
+// a job of higher priority is waiting for a core, and is resumed later
+// with its search state intact.
+//
+// A job runs in a thread of its own, which is started when the job is
+// first granted a core and joined as soon as it completes, so threads
+// are only alive for jobs which are running or preempted.
+struct Scheduler {
+
+  // Create a scheduler running at most cores jobs at once, or one per
+  // hardware thread if cores is zero or less. Submission blocks while
+  // max_queued jobs are waiting to start, or four per core if
+  // max_queued is zero or less.
+  Scheduler (int cores, int max_queued = 0);
+
+  virtual ~Scheduler ();
+
+  // Called from a job's thread as it completes. Calls are serialized.
+  virtual void job_done (int id IS_UNUSED, const Sched_Job &job IS_UNUSED) {}
+
+  // Queue a job, returning its identifier. Blocks until there is
+  // room in the queue.
+  int submit (const Sched_Job &job);
+
+  // Wait for every job to complete.
+  void finish ();
+
+  // Configuration.
+  const int cores;
+  const int max_queued;
+
+  // Statistics.
+  uint64 jobs_done;
+  uint64 total_cpu_time;
+
+private:
+
+  struct Entry;
+  struct Observer;
+
+  // Grant free cores to the best waiting jobs. The caller must hold m.
+  void dispatch ();
+
+  // Return the best waiting job. The caller must hold m.
+  std::list <Entry *> :: iterator best_waiting ();
+
+  // Called by a running job at an iteration boundary. Returns false if
+  // the job should end its search.
+  bool yield (Entry *e);
+
+  // Body of each job's thread.
+  void run (Entry *e);
+
+  // Take an engine from the pool or create a new one.
+  Search_Engine *take_engine ();
+
+  // Join the threads of completed jobs. The caller must hold m.
+  void reap ();
+
+  // Shared state, protected by m.
+  std::list <Entry *> waiting;
+  std::vector <Search_Engine *> idle_engines;
+  std::map <int, std::thread> threads;  // By job identifier.
+  std::vector <int> finished;           // Jobs whose threads are ending.
+  int queued;                           // Waiting jobs not yet started.
+  int running;
+  int outstanding;
+  int next_id;
+
+  std::mutex m;
+  std::condition_variable cv;
+
+  // Serializes calls to job_done.
+  std::mutex done_m;
+};
+
+// Entry point for "chesley schedule [--cores N] [--depth D] [--nodes
+// N]". Each line of standard input is a position, optionally preceded
+// by "priority <p>", "deadline <ms>", "depth <d>" or "nodes <n>", and a
+// line of results is written to standard output as each completes.
+int schedule_main (int argc, char **argv);
+
+#endif // _SCHEDULER_
@@ -15,6 +15,7 @@
 #include <cassert>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stdlib.h>
 
 #ifdef _WIN32
@@ -25,9 +26,6 @@
 
 using namespace std;
 
-// Reference to the pawn hash table.
-extern PHash ph;
-
 // Utility functions.
 bool is_mate (Score s) {
   return abs (s) > MATE_VAL - MAX_DEPTH;
@@ -74,7 +72,7 @@ Search_Engine :: do_ponder (const Board &b) {
 Score
 Search_Engine :: new_search
 (const Board &b, int depth, Move_Vector &pv) {
-  if (!Session::ponder_enabled)
+  if (!ponder_enabled)
     {
       // Age the history and mates tables.
       hh_max /= 4;
@@ -86,20 +84,19 @@ Search_Engine :: new_search
             mates_table[i][j] /= 4;
           }
 
-      // Age the killer and mate_killer tables.
+      // Age the killer and mate killer moves.
       for (int i = 0; i < MAX_PLY - 2; i++)
         {
-          killers[i] = killers[i + 2];
-          killers2[i] = killers[i + 2];
-          mate_killer[i] = mate_killer[i + 2];
+          ss[i].killers[0] = ss[i + 2].killers[0];
+          ss[i].killers[1] = ss[i + 2].killers[1];
+          ss[i].mate_killer = ss[i + 2].mate_killer;
         }
 
-      // Clear the last two elements of killer and mate killer tables.
-      for (int i = MAX_PLY - 2; i < MAX_PLY; i++)
+      // Clear the killers of the last two plies.
+      for (int i = MAX_PLY - 2; i < MAX_PLY + 2; i++)
         {
-          killers[i] = NULL_MOVE;
-          killers2[i] = NULL_MOVE;
-          mate_killer[i] = NULL_MOVE;
+          ss[i].killers[0] = ss[i].killers[1] = NULL_MOVE;
+          ss[i].mate_killer = NULL_MOVE;
         }
     }
   else
@@ -108,9 +105,7 @@ Search_Engine :: new_search
       ZERO (hh_table);
       mates_max = 0;
       ZERO (mates_table);
-      ZERO (killers);
-      ZERO (killers2);
-      ZERO (mate_killer);
+      clear_stack ();
     }
 
   // Clear statistics.
@@ -185,6 +180,7 @@ Search_Engine :: iterative_deepening
         }
 
       // Initialize statistics for this iteration.
+      stats.nodes += stats.calls_to_search + stats.calls_to_qsearch;
       stats.calls_to_search = stats.calls_to_qsearch = 0;
       start_time = mclock ();
 
@@ -201,11 +197,16 @@ Search_Engine :: iterative_deepening
       // Copy back the score and PV to the caller.
       pv = pv_tmp;
       s = s_tmp;
+      stats.depth = i;
 
       // Collect statistics.
       stats.calls_for_depth[i] = stats.calls_to_search + stats.calls_to_qsearch;
       stats.time_for_depth[i] = mclock () - start_time;
 
+      // Give an observer the chance to suspend or end the search.
+      if (observer && !observer -> iteration_done (*this, i))
+        break;
+
       // Because of techniques like grafting the results of searches
       // from the transposition table to shallow searches, etc., we
       // never know if we've found the quickest mate possible. Here we
@@ -269,20 +270,35 @@ root_search (const Board &b, int depth, Move_Vector &pv, Score guess)
   // Update statistics.
   stats.calls_to_search++;
 
+  // Nothing has been extended yet.
+  root_depth = depth;
+  ss[0].ext_carry = ss[0].ext_total = 0;
+
 #ifdef ENABLE_ASPIRATION_WINDOW
-  // Try an aspiration search.
-  const int ASPIRATION_WINDOW = 20;
-  Score lower = guess - ASPIRATION_WINDOW / 2;
-  Score upper = guess + ASPIRATION_WINDOW / 2;
-  cs = search_with_memory (b, depth, 0, pv, lower, upper);
-  if (cs > lower && cs < upper && pv.count > 0)
+  // Try an aspiration search. This would search every move, so it is
+  // skipped if any are excluded.
+  if (excluded.count == 0)
     {
-      stats.asp_hits++;
-      tt.set (b, EXACT_VALUE, pv[0], cs, depth);
-      return cs;
+      const int ASPIRATION_WINDOW = 20;
+      Score lower = guess - ASPIRATION_WINDOW / 2;
+      Score upper = guess + ASPIRATION_WINDOW / 2;
+      Board c = b;
+      cs = search_with_memory (c, depth, 0, pv, lower, upper);
+      if (cs > lower && cs < upper && pv.count > 0)
+        {
+          stats.asp_hits++;
+          tt.set (b, EXACT_VALUE, pv[0], cs, depth);
+          return cs;
+        }
     }
 #endif // ENABLE_ASPIRATION_WINDOW
 
+  ss[0].key = b.hash;
+
+  // Evaluate the root position for the improving test at ply 2.
+  ss[0].static_eval = b.in_check (b.to_move ()) ?
+    TTable::NO_EVAL : Eval (b, ph).score ();
+
   // Generate moves.
   Move_Vector moves (b);
   order_moves (b, 0, moves);
@@ -295,14 +311,15 @@ root_search (const Board &b, int depth, Move_Vector &pv, Score guess)
       int ext;
       Board c = b;
       Move m = moves[i];
-      path[0] = m;
+      ss[0].move = m;
       cpv.clear();
 
-      // Skip this move if it's illegal.
+      // Skip this move if it's excluded or illegal.
+      if (excluded.contains (m)) continue;
       if (!c.apply (m)) continue;
 
       // Decide on a depth adjustment for this search.
-      ext = depth_adjustment (b, m, 0);
+      ext = extend (0, depth_adjustment (b, m, 0));
 
       // Do principal variation search.
       if (i > 0)
@@ -325,8 +342,10 @@ root_search (const Board &b, int depth, Move_Vector &pv, Score guess)
 
     }
 
-  // Store this result in the transposition table.
-  tt.set (b, EXACT_VALUE, pv[0], alpha, depth);
+  // Store this result in the transposition table, unless it is not
+  // the true value of the position since moves were excluded.
+  if (excluded.count == 0)
+    tt.set (b, EXACT_VALUE, pv[0], alpha, depth);
 
   return alpha;
 }
@@ -342,7 +361,7 @@ root_search (const Board &b, int depth, Move_Vector &pv, Score guess)
 
 Score
 Search_Engine :: search_with_memory
-(const Board &b,
+(Board &b,
  int depth, int ply,
  Move_Vector &pv,
  Score alpha, Score beta,
@@ -394,7 +413,7 @@ Search_Engine :: search_with_memory
 
 Score
 Search_Engine :: search
-(const Board &b,
+(Board &b,
  int depth, int ply,
  Move_Vector &pv,
  Score alpha, Score beta,
@@ -403,11 +422,21 @@ Search_Engine :: search
   assert (pv.count == 0);
   int legal_move_count = 0;
   bool in_check = b.in_check ((b.to_move ()));
+  ss[ply].key = b.hash;
+  ss[ply].static_eval = TTable::NO_EVAL;
 
   // Check 50 move and triple repetition rules.
   if (b.half_move_clock == 100 || is_rep (b))
     return 0;
 
+  // If we can repeat a position we are at least drawing.
+  if (alpha < 0 && upcoming_rep (b, ply))
+    {
+      stats.cycle_count++;
+      alpha = 0;
+      if (alpha >= beta) return alpha;
+    }
+
   // Mate distance pruning.
   alpha = max (alpha, (Score) (-MATE_VAL + ply));
   beta = min (beta, (Score) (MATE_VAL - ply));
@@ -422,30 +451,211 @@ Search_Engine :: search
   // Otherwise recurse over the children of this node.
   else {
 
+    ///////////////////////
+    // Static evaluation //
+    ///////////////////////
+
+    // Evaluate this node once, unless we are in check, reusing the
+    // value stored in the transposition table if there is one.
+    if (!in_check)
+      {
+        ss[ply].static_eval = tt.get_eval (b);
+        if (ss[ply].static_eval == TTable::NO_EVAL)
+          ss[ply].static_eval = Eval (b, ph).score ();
+      }
+
+    const Score static_eval = ss[ply].static_eval;
+    const bool is_improving = improving (ply);
+
+#ifdef ENABLE_FUTILITY
+    // Node level pruning is only done at zero window nodes, where the
+    // exact value is not needed, and never near a mate score.
+    const bool prune_node =
+      !in_check && beta - alpha == 1 && !is_mate (alpha) && !is_mate (beta);
+
+    ///////////////////////////////
+    // Reverse futility pruning  //
+    ///////////////////////////////
+
+    // If the static evaluation beats beta by more than any move could
+    // reasonably lose, assume the node fails high without searching
+    // it. The margin is narrower if our position is improving.
+    if (prune_node && depth <= RFP_DEPTH)
+      {
+        Score margin =
+          2 * depth * PAWN_VAL - (is_improving ? PAWN_VAL / 2 : 0);
+        if (static_eval - margin >= beta)
+          {
+            stats.rfp_count[depth]++;
+            return static_eval - margin;
+          }
+      }
+
+    //////////////
+    // Razoring //
+    //////////////
+
+    // If our position is getting worse and the static evaluation is
+    // so far below alpha that only a capture could save us, verify
+    // this with a quiescence search and return its value if it can
+    // not reach alpha either.
+    if (prune_node && depth <= RAZOR_DEPTH && !is_improving)
+      {
+        static const Score RAZOR_MARGIN[RAZOR_DEPTH + 1] =
+          { 0, 3 * PAWN_VAL };
+
+        Score ralpha = alpha - RAZOR_MARGIN[depth];
+        if (static_eval <= ralpha)
+          {
+            Score val = qsearch (b, -1, ply, ralpha, ralpha + 1);
+            if (val <= ralpha)
+              {
+                stats.razor_count[depth]++;
+                return val;
+              }
+          }
+      }
+#endif // ENABLE_FUTILITY
+
 #ifdef ENABLE_NULL_MOVE
     /////////////////////////
     // Null move heuristic //
     /////////////////////////
 
-    const int R = depth >= 6 ? 3 : 2;
-    if (do_null_move && !in_check && b.has_piece ())
+    // The reduction grows with depth and with the amount by which the
+    // static evaluation exceeds beta. At depths of VERIFY_DEPTH and
+    // more a null move fail high is verified by a reduced search
+    // without null moves, which protects against zugzwang; shallower
+    // fail highs are trusted as they are.
+    const int VERIFY_DEPTH = 8;
+
+    if (do_null_move && !in_check && ply > 0 && b.has_piece () &&
+        static_eval >= beta)
       {
-        Board c = b;
+        int R = 2 + depth / 6 +
+          min ((static_eval - beta) / (2 * PAWN_VAL), 2);
+
+        // The null move is made in place and taken back before
+        // anything else looks at the board, even if the search is
+        // interrupted.
+        Undo u;
         Move_Vector dummy;
-        c.set_color (~c.to_move ());
-        c.set_en_passant (0);
-        int val = -search_with_memory
-          (c, depth - R - 1, ply, dummy, -beta, -beta + 1, false);
+        b.apply_null (u);
+        ss[ply].move = NULL_MOVE;
+        extend (ply, 0);
+        int val;
+        try
+          {
+            val = -search_with_memory
+              (b, depth - R - 1, ply + 1, dummy, -beta, -beta + 1, false);
+          }
+        catch (...)
+          {
+            b.unapply_null (u);
+            throw;
+          }
+        b.unapply_null (u);
+
+        // Don't trust a mate found after passing.
+        if (is_mate (val))
+          val = beta;
 
         if (val >= beta)
           {
-            stats.null_count++;
-            return val;
+            if (depth < VERIFY_DEPTH)
+              {
+                stats.null_count++;
+                return val;
+              }
+
+            Move_Vector vpv;
+            stats.null_verify_count++;
+            Score vs = search
+              (b, depth - R - 1, ply, vpv, beta - 1, beta, false);
+
+            if (vs >= beta)
+              {
+                stats.null_count++;
+                return val;
+              }
+
+            stats.null_verify_fails++;
           }
       }
 
 #endif // ENABLE_NULL_MOVE
 
+#ifdef ENABLE_PROBCUT
+    /////////////
+    // ProbCut //
+    /////////////
+
+    // At deep zero window nodes, if a good capture searched to a
+    // reduced depth beats beta by a margin then a full depth search
+    // would very likely fail high as well, so we cut here.
+    const int PROBCUT_DEPTH = 5;
+    const int PROBCUT_REDUCTION = 4;
+    const Score PROBCUT_MARGIN = 2 * PAWN_VAL;
+
+    // Set if ProbCut was tried here and failed to cut, in which case
+    // the cost of the full search is recorded below.
+    bool probcut_failed = false;
+    uint64 full_start = 0;
+
+    if (!in_check && beta - alpha == 1 && depth >= PROBCUT_DEPTH &&
+        depth < MAX_DEPTH && !is_mate (beta))
+      {
+        Score pbeta = beta + PROBCUT_MARGIN;
+        int pdepth = depth - PROBCUT_REDUCTION;
+        stats.probcut_tested++;
+
+        // Don't bother if the table already shows that a search as deep
+        // as ours, which searches each capture to pdepth from the child,
+        // fails to reach the raised beta.
+        Move hash_move;
+        Score hash_score;
+        int hash_depth;
+        SKind hash_skind = tt.lookup (b, hash_move, hash_score, hash_depth);
+        bool refuted =
+          (hash_skind == UPPER_BOUND || hash_skind == EXACT_VALUE) &&
+          hash_depth >= pdepth + 1 && hash_score < pbeta;
+
+        Move_Vector captures;
+        if (!refuted)
+          b.gen_captures (captures);
+
+        uint64 start_nodes = node_count ();
+        for (int i = 0; i < captures.count; i++)
+          {
+            Board c = b;
+            Move m = captures[i];
+            Move_Vector cpv;
+
+            // Only try captures which could plausibly reach pbeta.
+            if (static_eval + see (b, m) < pbeta) continue;
+            if (!c.apply (m)) continue;
+
+            stats.probcut_tries++;
+            ss[ply].move = m;
+            extend (ply, 0);
+            Score val = -search_with_memory
+              (c, pdepth, ply + 1, cpv, -pbeta, -pbeta + 1, true);
+
+            if (val >= pbeta)
+              {
+                stats.probcut_cuts[depth]++;
+                stats.probcut_nodes += node_count () - start_nodes;
+                pv = Move_Vector (m, cpv);
+                return val;
+              }
+          }
+
+        stats.probcut_nodes += node_count () - start_nodes;
+        probcut_failed = true;
+        full_start = node_count ();
+      }
+#endif // ENABLE_PROBCUT
+
     ///////////////////////////
     // Minimax over children //
     ///////////////////////////
@@ -469,8 +679,7 @@ Search_Engine :: search
         int count = 0;
         for (int i = 0; i < moves.count; i++)
           {
-            Board c = b;
-            if (c.apply (moves[i])) count++;
+            if (b.is_legal (moves[i])) count++;
             if (count > 1) break;
           }
 
@@ -483,35 +692,40 @@ Search_Engine :: search
       }
 #endif
 
+    // Checking squares for the moves below.
+    const Board::Check_Info ci (b);
+
     for (mi = 0; mi < moves.count; mi++)
       {
         int cs;
         Move m = moves[mi];
-        path[ply] = m;
+        ss[ply].move = m;
+        ss[ply].reduction = 0;
         Move_Vector cpv;
-        Board c = b;
 
         // Skip this move if it's illegal.
-        if (!c.apply (m)) continue;
+        if (!b.is_legal (m)) continue;
 
         legal_move_count++;
 
         // Determine the estimated evaluation for this move.
-        Score estimate = net_material (b) + see (b, m);
+        Score estimate = (static_eval != TTable::NO_EVAL ?
+                          static_eval : net_material (b)) + see (b, m);
 
-        // Determine whether this moves checks.
-        bool c_in_check = c.in_check (c.to_move());
+        // Determine whether this moves checks. Moves are only made once
+        // they survive pruning.
+        bool c_in_check = b.gives_check (m, ci);
 
         // Decide on a depth adjustment for this search.
-        int ext = depth_adjustment (b, m, ply);
-        if (sre) ext++;
+        int frac = depth_adjustment (b, m, ply);
+        if (sre) frac += SINGLE_REPLY_EXT;
+        int ext = extend (ply, frac);
 
 #ifdef ENABLE_FUTILITY
         // The approach taken to futility pruning here come from Ernst
         // A. Heinz and his discussion of pruning in Deep Thought at
         // http://people.csail.mit.edu/heinz/dt.
 
-        const int PRE_PRE_FRONTIER = 3;
         const int PRE_FRONTIER = 2;
         const int FRONTIER = 1;
 
@@ -526,8 +740,10 @@ Search_Engine :: search
 
             // At frontier nodes we estimate the most this move
             // could reasonably improve the score of the position,
-            // and if it still isn't better than alpha we skip it.
-            const Score FUTILITY_MARGIN = 3 * PAWN_VAL;
+            // and if it still isn't better than alpha we skip it. The
+            // margin is narrower if our position is getting worse.
+            const Score FUTILITY_MARGIN =
+              is_improving ? 3 * PAWN_VAL : 2 * PAWN_VAL;
             upperbound = estimate + FUTILITY_MARGIN;
             if (depth == FRONTIER && upperbound < alpha)
               {
@@ -548,23 +764,12 @@ Search_Engine :: search
                 stats.ext_futility_count++;
                 continue;
               }
-
-            ////////////////////////////////////////
-            // Razoring at pre-pre frontier nodes //
-            ////////////////////////////////////////
-
-            // If this position looks extremely bad at depth three,
-            // proceed with a reduced depth search.
-            const Score RAZORING_MARGIN = QUEEN_VAL + PAWN_VAL;
-            upperbound = estimate + RAZORING_MARGIN;
-            if (depth == PRE_PRE_FRONTIER && upperbound <= alpha)
-              {
-                stats.razor_count++;
-                depth = PRE_FRONTIER;
-              }
           }
 #endif // ENABLE_FUTILITY
 
+        Board c = b;
+        c.apply (m);
+
 #ifdef ENABLE_PVS
 
         ////////////////////////////////
@@ -579,15 +784,20 @@ Search_Engine :: search
             // Late move reductions //
             //////////////////////////
 
-            const int Full_Depth_Count = 4;
+            // Begin reducing one move sooner if our position is not
+            // improving.
+            const int Full_Depth_Count = is_improving ? 4 : 3;
             const int Reduction_Limit = 3;
 
             if (mi >= Full_Depth_Count && depth >= Reduction_Limit &&
                 m.get_promote () != QUEEN &&
                 ext == 0 && !in_check && !c_in_check)
               {
+                ss[ply].reduction = 1;
+
                 cs = -search_with_memory
-                  (c, depth - 2, ply + 1, cpv, -alpha - 1, -alpha, true);
+                  (c, depth - 1 - ss[ply].reduction, ply + 1, cpv,
+                   -alpha - 1, -alpha, true);
 
                 if (cs > alpha)
                   {
@@ -666,6 +876,14 @@ Search_Engine :: search
             stats.hist_pv[min (mi, hist_nbuckets - 1)]++;
           }
       }
+
+#ifdef ENABLE_PROBCUT
+    if (probcut_failed)
+      {
+        stats.probcut_full_count[depth]++;
+        stats.probcut_full_nodes[depth] += node_count () - full_start;
+      }
+#endif // ENABLE_PROBCUT
   }
 
   return alpha;
@@ -677,9 +895,9 @@ Search_Engine::collect_fail_high
 (int ply, const Move &m, Score s, int mi)
 {
   // Update the mate killer move.
-  if (mi > 0 && is_mate (s) && s > 0 && mate_killer[ply] != m)
+  if (mi > 0 && is_mate (s) && s > 0 && ss[ply].mate_killer != m)
     {
-      mate_killer[ply] = m;
+      ss[ply].mate_killer = m;
     }
   else
     {
@@ -687,11 +905,11 @@ Search_Engine::collect_fail_high
       if (mi > 0 &&
           !m.is_capture () &&
           m.get_promote () != QUEEN &&
-          killers[ply] != m)
+          ss[ply].killers[0] != m)
         {
-          killers2[ply] = killers[ply];
-          killers[ply] = m;
-          assert (killers[ply] != killers2[ply]);
+          ss[ply].killers[1] = ss[ply].killers[0];
+          ss[ply].killers[0] = m;
+          assert (ss[ply].killers[0] != ss[ply].killers[1]);
         }
     }
 }
@@ -750,13 +968,13 @@ Search_Engine :: order_moves
         }
 
       // Apply mate move bonus.
-      if (m == mate_killer[ply])
+      if (m == ss[ply].mate_killer)
         {
           scores[i] += MATE_KILLER;
           continue;
         }
 
-      if (ply >= 2 && m == mate_killer[ply - 2])
+      if (ply >= 2 && m == ss[ply - 2].mate_killer)
         {
           scores[i] += MATE_KILLER - 1;
           continue;
@@ -768,7 +986,7 @@ Search_Engine :: order_moves
           Score sval = see (b, m);
 
           // Order recaptures early.
-          if (ply > 0 && path[ply - 1].to == m.to)
+          if (ply > 0 && ss[ply - 1].move.to == m.to)
             {
               scores[i] = RECAPTURE + sval;
               continue;
@@ -797,25 +1015,25 @@ Search_Engine :: order_moves
         }
 
       // Apply killer move bonus.
-      if (m == killers[ply])
+      if (m == ss[ply].killers[0])
         {
           scores[i] += KILLER_1;
           continue;
         }
 
-      if (ply >= 2 && m == killers[ply - 2])
+      if (ply >= 2 && m == ss[ply - 2].killers[0])
         {
           scores[i] += KILLER_1 - 1;
           continue;
         }
 
-      if (m == killers2[ply])
+      if (m == ss[ply].killers[1])
         {
           scores[i] += KILLER_2;
           continue;
         }
 
-      if (ply >= 2 && m == killers2[ply - 2])
+      if (ply >= 2 && m == ss[ply - 2].killers[1])
         {
           scores[i] += KILLER_2 - 1;
           continue;
@@ -843,7 +1061,7 @@ Search_Engine :: order_moves
   moves.sort (scores);
 }
 
-// Return a depth adjustment for a position.
+// Return a depth adjustment for a position in fractions of a ply.
 int Search_Engine::depth_adjustment (const Board &b, Move m, int ply) {
 #ifdef ENABLE_EXTENSIONS
   int ext = 0;
@@ -851,31 +1069,53 @@ int Search_Engine::depth_adjustment (const Board &b, Move m, int ply) {
   // Check extension.
   if (b.in_check (b.to_move ()))
     {
-      ext++;
+      ext += CHECK_EXT;
     }
 
   // Recapture extension.
   if (ply > 0 &&
-      path[ply - 1].is_capture () &&
-      path[ply].to == path[ply - 1].to)
+      ss[ply - 1].move.is_capture () &&
+      ss[ply].move.to == ss[ply - 1].move.to)
     {
-      ext++;
+      ext += RECAPTURE_EXT;
     }
 
   // Pawn to seventh rank extension.
   int rank = idx_to_rank (m.to);
   if ((rank == 1 || rank == 6) && m.get_kind () == PAWN)
     {
-      ext += 1;
+      ext += PAWN_7TH_EXT;
     }
 
-  stats.ext_count += ext;
   return ext;
 #else
   return 0;
 #endif // ENABLE_EXTENSIONS
 }
 
+// Add frac to the extension carried to ply + 1 and return the whole
+// plies by which to extend its search. No path may be extended by more
+// plies in total than the depth of the iteration underway, which keeps
+// long forcing sequences from blowing up the tree.
+int Search_Engine::extend (int ply, int frac) {
+  int carry = ss[ply].ext_carry + frac;
+  int ext = carry / ONE_PLY;
+  int total = ss[ply].ext_total + ext;
+
+  if (total > root_depth)
+    {
+      stats.ext_budget_count++;
+      ext -= total - root_depth;
+      total = root_depth;
+      carry = 0;
+    }
+
+  ss[ply + 1].ext_carry = carry % ONE_PLY;
+  ss[ply + 1].ext_total = total;
+  stats.ext_count += ext;
+  return ext;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Search_Engine :: see ()                                          //
@@ -1021,7 +1261,7 @@ Search_Engine :: qsearch
   stats.calls_to_qsearch++;
 
   // Do static evaluation at this node.
-  Score static_eval = Eval (b, alpha, beta).score ();
+  Score static_eval = Eval (b, ph, alpha, beta).score ();
 
   // Delta pruning.
   if (static_eval + QUEEN_VAL < alpha)
@@ -1060,6 +1300,16 @@ Search_Engine :: qsearch
                 {
                   scores[i] = PAWN_VAL;
                 }
+
+              // A capture of a piece worth at least as much as the
+              // capturing piece can't lose material, so we skip the
+              // exchange evaluation and order it by MVV/LVA.
+              else if (moves[i].is_capture () &&
+                       victim_value (moves[i]) >= attacker_value (moves[i]))
+                {
+                  scores[i] = capture_value (moves[i]);
+                  stats.qmvv_count++;
+                }
               else
                 {
                   scores[i] = see (b, moves[i]);
@@ -1074,12 +1324,28 @@ Search_Engine :: qsearch
           moves.sort (scores);
 
           // Minimax over captures.
+          const Score DELTA_MARGIN = 2 * PAWN_VAL;
           int mi = 0;
           for (mi = 0; mi < moves.count; mi++)
             {
-              if (scores[mi] < 0) break;
-
               Move m = moves[mi];
+
+              // Stop at the first capture which loses material.
+              if (scores[mi] < 0)
+                {
+                  stats.qsee_count += moves.count - mi;
+                  break;
+                }
+
+              // Skip captures which can't bring the score close to
+              // alpha even if the piece is won for free.
+              if (m.is_capture () && m.get_promote () == NULL_KIND &&
+                  static_eval + victim_value (m) + DELTA_MARGIN <= alpha)
+                {
+                  stats.qdelta_count++;
+                  continue;
+                }
+
               c = b;
               if (c.apply (m))
                 {
@@ -1230,8 +1496,19 @@ Search_Engine :: tt_update
   if (depth > old_depth)
 #endif
 
-    // Update the entry.
-    tt.set (b, skind, m, s, depth);
+    // Update the entry, along with the static evaluation if this
+    // node computed one.
+    tt.set (b, skind, m, s, depth, ss[ply].static_eval);
+
+  // Share deep entries.
+  TTable::Entry e;
+  if (tt_export && !tt_export -> empty () && depth >= tt_export_depth &&
+      tt.fetch (b.hash, e))
+    {
+      TTable::Entry &slot = (*tt_export)[e.key % tt_export -> size ()];
+      if (slot.key == e.key || e.depth >= slot.depth)
+        slot = e;
+    }
 
 #endif // ENABLE_TRANS_TABLE
 }
@@ -1281,6 +1558,53 @@ Search_Engine :: rep_count (const Board &b) {
     }
 }
 
+// Test whether the side to move can repeat a position on the current
+// search path with a single reversible move. The difference between
+// the hash of this position and one an odd number of plies earlier is
+// looked up in the cuckoo tables of reversible moves, and if a match
+// is found we check that nothing stands between its two squares and
+// that the side to move owns the piece. This is the method described
+// by Marcel van Kervinck.
+bool
+Search_Engine :: upcoming_rep (const Board &b, int ply) const {
+  int end = min ((int) b.half_move_clock, ply);
+
+  // A null move breaks any cycle.
+  for (int i = 1; i <= end; i++)
+    if (ss[ply - i].move == NULL_MOVE)
+      {
+        end = i - 1;
+        break;
+      }
+
+  for (int i = 3; i <= end; i += 2)
+    {
+      hash_t key = b.hash ^ ss[ply - i].key;
+
+      uint32 j = cuckoo_h1 (key);
+      if (cuckoo_keys[j] != key)
+        {
+          j = cuckoo_h2 (key);
+          if (cuckoo_keys[j] != key)
+            continue;
+        }
+
+      Coord from = cuckoo_moves[j] & 63, to = cuckoo_moves[j] >> 6;
+      if (between[from * 64 + to] & b.occupied)
+        continue;
+
+      // The keys do not say whose piece moves, so unless the position
+      // repeated lies strictly inside the search path the piece must
+      // belong to the side to move. Otherwise the opponent's moves
+      // might merely net to this displacement.
+      Coord sq = test_bit (b.occupied, from) ? from : to;
+      if (i < ply || b.get_color (sq) == b.to_move ())
+        return true;
+    }
+
+  return false;
+}
+
 // Test whether this board is a repetition.
 bool
 Search_Engine :: is_rep (const Board &b) {
@@ -1371,7 +1695,29 @@ Search_Engine :: poll () {
   const uint64 nodes = stats.calls_to_qsearch + stats.calls_to_search;
   const uint64 period = 64 * 1024;
 
-  if (nodes > 0 && nodes % period == 0) Session::poll ();
+  // Halt once a fixed node budget is spent, provided at least one
+  // iteration has completed so that there is a move to return.
+  if (controls.fixed_nodes > 0 && stats.depth > 0 &&
+      node_count () >= (uint64) controls.fixed_nodes)
+    {
+      controls.interrupt_search = true;
+      throw SEARCH_INTERRUPTED;
+    }
+
+  if (nodes > 0 && nodes % period == 0)
+    {
+      if (session_poll)
+        {
+          Session::poll ();
+        }
+      else if (stats.depth > 0 &&
+               (stop || (controls.deadline > 0 &&
+                         (int64) mclock () >= controls.deadline)))
+        {
+          controls.interrupt_search = true;
+          throw SEARCH_INTERRUPTED;
+        }
+    }
 }
 
 // Set fixed depth per move.
@@ -1381,6 +1727,13 @@ Search_Engine :: set_fixed_depth (int depth) {
   return;
 }
 
+// Set a fixed number of nodes per move.
+void
+Search_Engine :: set_fixed_nodes (int64 nodes) {
+  controls.fixed_nodes = nodes;
+  return;
+}
+
 // Set fixed time per move in milliseconds.
 void
 Search_Engine :: set_fixed_time (int time) {
@@ -1526,6 +1879,8 @@ Search_Engine :: post_after () {
   cout << "tt hit rate " << hit_rate * 100 << "%, ";
   double coll_rate = (double) tt.collisions / tt.writes;
   cout << "coll rate " << coll_rate * 100 << "%, ";
+  if (tt.is_shared ())
+    cout << "shared hits " << (double) tt.shared_hits / tt.hits * 100 << "%, ";
 
   hit_rate = (double) ph.hits / (ph.hits + ph.misses);
   cout << "ph hit " << hit_rate * 100 << "%, ";
@@ -1533,14 +1888,42 @@ Search_Engine :: post_after () {
   cout << "ph coll " << coll_rate * 100 << "%, ";
 
   // Display performance of heuristics.
-  cout << "asp: "   << stats.asp_hits << endl;
+  cout << "asp: "   << stats.asp_hits;
+  cout << ", cyc: " << stats.cycle_count << endl;
   cout << "null: "  << stats.null_count;
+  cout << " (" << stats.null_verify_fails << "/" << stats.null_verify_count;
+  cout << " failed verification)";
   cout << ", ext: " << stats.ext_count;
-  cout << " rzr: "  << stats.razor_count;
+  cout << " (" << stats.ext_budget_count << " over budget)";
   cout << ", fut: " << stats.futility_count;
   cout << ", xft: " << stats.ext_futility_count;
   cout << ", lmr: " << stats.lmr_count << endl;
+  // Estimate the nodes ProbCut saved from the average cost of the
+  // full searches of nodes at the same depth it failed to cut.
+  uint64 pc_cuts = 0;
+  double pc_saved = -(double) stats.probcut_nodes;
+  for (int d = 0; d < MAX_DEPTH; d++)
+    {
+      pc_cuts += stats.probcut_cuts[d];
+      if (stats.probcut_full_count[d] > 0)
+        pc_saved += (double) stats.probcut_cuts[d] *
+          stats.probcut_full_nodes[d] / stats.probcut_full_count[d];
+    }
+  cout << "probcut: " << pc_cuts << "/" << stats.probcut_tested;
+  cout << " nodes cut (" << stats.probcut_tries << " captures), ";
+  cout << stats.probcut_nodes << " nodes spent, ";
+  cout << (int64) pc_saved << " saved" << endl;
+  cout << "rfp by depth:";
+  for (int i = 1; i <= RFP_DEPTH; i++)
+    cout << " " << stats.rfp_count[i];
+  cout << ", rzr by depth:";
+  for (int i = 1; i <= RAZOR_DEPTH; i++)
+    cout << " " << stats.razor_count[i];
+  cout << endl;
   cout << "dlt: "   << stats.delta_count;
+  cout << ", qdlt: " << stats.qdelta_count;
+  cout << ", qsee: " << stats.qsee_count;
+  cout << ", qmvv: " << stats.qmvv_count;
 
   // Display nodes per second.
   uint64 total_nodes = 0;
@@ -1560,3 +1943,20 @@ Search_Engine :: post_after () {
       cout << "? knps." << endl;
     }
 }
+
+// Return a one line summary of the last search of b.
+string
+Search_Engine :: summary (const Board &b, Score s, const Move_Vector &pv) const
+{
+  ostringstream out;
+
+  out << "move " << (pv.count > 0 ? b.to_calg (pv[0]) : string ("none"))
+      << " score " << s
+      << " depth " << stats.depth
+      << " nodes " << node_count ()
+      << " pv";
+  for (int i = 0; i < pv.count; i++)
+    out << " " << b.to_calg (pv[i]);
+
+  return out.str ();
+}
@@ -15,11 +15,15 @@
 #ifndef _SEARCH_
 #define _SEARCH_
 
+#include <atomic>
 #include <cstring>
 #include <map>
+#include <string>
+#include <vector>
 
 #include "board.hpp"
 #include "eval.hpp"
+#include "phash.hpp"
 #include "ttable.hpp"
 #include "util.hpp"
 
@@ -31,21 +35,42 @@ static const int32 MAX_DEPTH = 256;
 static const int32 MAX_PLY = 256;
 static const int   hist_nbuckets = 10;
 
+// Return true if s is the score of a forced mate.
+bool is_mate (Score s);
+
+struct Search_Engine;
+
+// An observer notified by a search engine at iteration boundaries.
+struct Search_Observer {
+  virtual ~Search_Observer () {}
+
+  // Called after each completed iteration of iterative deepening. The
+  // search ends, returning its result so far, if this returns false.
+  virtual bool iteration_done (Search_Engine &se, int depth) = 0;
+};
+
 struct Search_Engine {
 
   ///////////////
   // Constants //
   ///////////////
 
-  // Transposition table size in entries where each entry is 16 bytes
+  // Transposition table size in entries where each entry is 32 bytes
   // long. This should be a power of 2.
   static const uint32 TT_SIZE = 1 * 1024 * 1024;
 
+  // Pawn structure cache size in entries where each entry is 16 bytes
+  // long.
+  static const uint32 PH_SIZE = 1 * 1024 * 1024;
+
   /////////////////////////////////////
   // Constructors and initialization //
   /////////////////////////////////////
 
-  Search_Engine () : tt (TT_SIZE) {
+  Search_Engine (uint32 tt_size = TT_SIZE) :
+    tt (tt_size), ph (PH_SIZE), ponder_enabled (false),
+    session_poll (true), stop (false), observer (NULL),
+    tt_export (NULL), tt_export_depth (0) {
     reset ();
   }
 
@@ -68,14 +93,16 @@ struct Search_Engine {
     controls.increment = -1;
     controls.fixed_time = -1;
     controls.fixed_depth = -1;
+    controls.fixed_nodes = -1;
     controls.time_remaining = -1;
     controls.moves_remaining = -1;
     controls.interrupt_search = false;
     controls.deadline = -1;
     controls.allocated = 1;
 
-    // Transposition and repetition tables.
+    // Transposition, pawn and repetition tables.
     tt.clear ();
+    ph.clear ();
     rt.clear ();
 
     // Output generation.
@@ -89,25 +116,43 @@ struct Search_Engine {
     ZERO (mates_table)
     mates_max = 0;
 
-    // Initialize the killer and mates moves.
-    ZERO (killers);
-    ZERO (killers2);
-    ZERO (mate_killer);
+    // Initialize the search stack.
+    clear_stack ();
+    root_depth = 0;
+
+    // Search every root move.
+    excluded.clear ();
   }
 
   // Clear accumulated search statistics.
   void clear_statistics () {
     tt.clear_statistics ();
     stats.asp_hits = 0;
+    stats.cycle_count = 0;
     stats.calls_to_qsearch = 0;
     stats.calls_to_search = 0;
     stats.delta_count = 0;
     stats.ext_count = 0;
+    stats.ext_budget_count = 0;
     stats.ext_futility_count = 0;
     stats.futility_count = 0;
     stats.lmr_count = 0;
     stats.null_count = 0;
-    stats.razor_count = 0;
+    stats.qdelta_count = 0;
+    stats.qmvv_count = 0;
+    stats.qsee_count = 0;
+    stats.null_verify_count = 0;
+    stats.null_verify_fails = 0;
+    stats.probcut_nodes = 0;
+    stats.probcut_tested = 0;
+    stats.probcut_tries = 0;
+    ZERO (stats.probcut_cuts);
+    ZERO (stats.probcut_full_count);
+    ZERO (stats.probcut_full_nodes);
+    ZERO (stats.razor_count);
+    ZERO (stats.rfp_count);
+    stats.nodes = 0;
+    stats.depth = 0;
     ZERO (stats.calls_for_depth);
     ZERO (stats.time_for_depth);
     ZERO (stats.hist_pv);
@@ -121,6 +166,9 @@ struct Search_Engine {
   // Transposition table instance.
   TTable tt;
 
+  // Pawn structure cache instance.
+  PHash ph;
+
   // Try to get a move or tighten the window from the transposition
   // table, returning true if we found a move we can return at this
   // position.
@@ -155,6 +203,10 @@ struct Search_Engine {
   // Fetch the repetition count for a position.
   int rep_count (const Board &b);
 
+  // Test whether the side to move can repeat a position on the
+  // current search path with a single reversible move.
+  bool upcoming_rep (const Board &b, int ply) const;
+
   // Test whether this board is a repetition.
   bool is_rep (const Board &b);
 
@@ -172,6 +224,10 @@ struct Search_Engine {
     Move_Vector pv;       // Reply and pondered position.
   } ponder;
 
+  // Is pondering enabled? If so the heuristic tables are cleared
+  // rather than aged between searches.
+  bool ponder_enabled;
+
   // Do a search and generate a move for the passed position.
   void do_ponder (const Board &b);
 
@@ -182,12 +238,36 @@ struct Search_Engine {
   // Poll is called periodically either by the caller or during search.
   inline void poll ();
 
-  // Set fixed time per move in milliseconds.
-  void set_fixed_depth (int depth);
+  // If true, this engine belongs to the Session and poll defers to
+  // Session::poll. Otherwise the engine enforces its own deadline.
+  bool session_poll;
+
+  // May be set from another thread to halt the search underway in an
+  // engine which does not belong to the Session. The owner clears it
+  // once the search it was meant for has returned.
+  std::atomic <bool> stop;
+
+  // If not NULL, notified after each completed iteration.
+  Search_Observer *observer;
+
+  // If not NULL, transposition table entries stored for searches of
+  // at least tt_export_depth plies are also kept here, so that they
+  // may be shared with other engines. The owner sizes the vector and
+  // zeroes it; each entry goes to the slot given by its key modulo the
+  // size, replacing an older entry for the same key or a shallower one
+  // for another, so the vector never grows.
+  std::vector <TTable::Entry> *tt_export;
+  int tt_export_depth;
 
   // Set fixed depth per move.
+  void set_fixed_depth (int depth);
+
+  // Set fixed time per move in milliseconds.
   void set_fixed_time (int time);
 
+  // Set a fixed number of nodes per move.
+  void set_fixed_nodes (int64 nodes);
+
   // Setup time controls corresponding to and xboard "level" command.
   void set_level (int mptc, int tptc, int inc);
 
@@ -207,6 +287,7 @@ struct Search_Engine {
     int increment;       // Increment in ICS mode.
     int fixed_time;      // Fixed milliseconds per move.
     int fixed_depth;     // Absolute fixed depth per move.
+    int64 fixed_nodes;   // Fixed nodes per move.
 
     ////////////////////////////////////////////////////////////////
     // Resources remaining for this games. In all case a negative //
@@ -243,6 +324,10 @@ struct Search_Engine {
   // Write thinking output after iterative deepening ends.
   void post_after ();
 
+  // Return a one line summary of the last search of b, in the form
+  // "move <calg> score <cp> depth <ply> nodes <n> pv <calg> ...".
+  std::string summary (const Board &b, Score s, const Move_Vector &pv) const;
+
   ////////////////
   // Statistics //
   ////////////////
@@ -250,10 +335,17 @@ struct Search_Engine {
   // The start time of some operation being timed.
   uint64 start_time;
 
+  // The greatest depths at which whole nodes are pruned by reverse
+  // futility pruning and by razoring.
+  static const int RFP_DEPTH = 3;
+  static const int RAZOR_DEPTH = 1;
+
   // Count the number of times search and qsearch have been called.
   struct {
     uint64 calls_to_qsearch;
     uint64 calls_to_search;
+    uint64 nodes;    // Nodes searched in earlier iterations.
+    int    depth;    // Last fully completed iteration.
     uint64 calls_for_depth[MAX_DEPTH];
     uint64 time_for_depth[MAX_DEPTH];
 
@@ -266,20 +358,86 @@ struct Search_Engine {
 
     // Counts of hits for various heuristics.
     uint64 asp_hits;
+    uint64 cycle_count;
     uint64 delta_count;
     uint64 ext_count;
+    uint64 ext_budget_count;
     uint64 ext_futility_count;
     uint64 futility_count;
     uint64 lmr_count;
     uint64 null_count;
-    uint64 razor_count;
+    uint64 qdelta_count;
+    uint64 qmvv_count;
+    uint64 qsee_count;
+    uint64 null_verify_count;
+    uint64 null_verify_fails;
+    uint64 probcut_nodes;   // Nodes spent on ProbCut searches.
+    uint64 probcut_tested;  // Nodes at which ProbCut was tried.
+    uint64 probcut_tries;   // Captures searched by ProbCut.
+
+    // ProbCut cuts by depth, and the number of nodes ProbCut failed to
+    // cut along with the nodes their full searches took, from which
+    // the nodes saved by each cut are estimated.
+    uint64 probcut_cuts[MAX_DEPTH];
+    uint64 probcut_full_count[MAX_DEPTH];
+    uint64 probcut_full_nodes[MAX_DEPTH];
+    uint64 razor_count[RAZOR_DEPTH + 1];
+    uint64 rfp_count[RFP_DEPTH + 1];
   } stats;
 
+  // Return the total number of nodes searched by this search.
+  uint64 node_count () const {
+    return stats.nodes + stats.calls_to_search + stats.calls_to_qsearch;
+  }
+
   //////////////////////////////
   // Search state information //
   //////////////////////////////
 
-  Move path[MAX_DEPTH];
+  // State kept for each ply of the search underway, along with the
+  // killer moves found at that ply by earlier searches.
+  struct Stack_Entry {
+    hash_t key;        // Hash of the position at this ply.
+    Move  move;        // The move being searched from this ply.
+    Move  killers[2];  // Quiet moves which recently failed high.
+    Move  mate_killer; // A move which recently led to a mate.
+    Score static_eval; // Static evaluation, or NO_EVAL if in check.
+    int   reduction;   // Depth reduction of the move being searched.
+    int   ext_carry;   // Fraction of a ply of extension carried down.
+    int   ext_total;   // Whole plies of extension taken on this path.
+  };
+
+  Stack_Entry ss[MAX_PLY + 2];
+
+  // Reset every entry of the search stack.
+  void clear_stack () {
+    for (int i = 0; i < MAX_PLY + 2; i++)
+      {
+        ss[i].key = 0;
+        ss[i].move = NULL_MOVE;
+        ss[i].killers[0] = ss[i].killers[1] = NULL_MOVE;
+        ss[i].mate_killer = NULL_MOVE;
+        ss[i].static_eval = TTable::NO_EVAL;
+        ss[i].reduction = 0;
+        ss[i].ext_carry = ss[i].ext_total = 0;
+      }
+  }
+
+  // Return true if the static evaluation at ply is better than it was
+  // two plies earlier, when the same side was to move. With nothing to
+  // compare against we assume it is.
+  bool improving (int ply) const {
+    if (ss[ply].static_eval == TTable::NO_EVAL)
+      return false;
+    if (ply < 2 || ss[ply - 2].static_eval == TTable::NO_EVAL)
+      return true;
+    return ss[ply].static_eval > ss[ply - 2].static_eval;
+  }
+
+  // Moves not to be searched at the root. Searching with the best move
+  // excluded gives the value of the best alternative, as in a multi-PV
+  // search. At least one legal root move must remain.
+  Move_Vector excluded;
 
   //////////////////////////////////
   // Hierarchy of search routines //
@@ -305,7 +463,7 @@ struct Search_Engine {
 
   // Memoized minimax search.
   Score search_with_memory
-  (const Board &b,
+  (Board &b,
    int depth, int ply,
    Move_Vector &pv,
    Score alpha = -INF, Score beta = INF,
@@ -313,7 +471,7 @@ struct Search_Engine {
 
   // Minimax search.
   Score search
-  (const Board &b,
+  (Board &b,
    int depth, int ply,
    Move_Vector &pv,
    Score alpha = -INF, Score beta = INF,
@@ -331,9 +489,24 @@ struct Search_Engine {
   // Heuristically order a list of moves by estimated value.
   void order_moves (const Board &b, int ply, Move_Vector &moves);
 
-  // Return on a depth adjustment for a position.
+  // Extensions are weighed in fractions of a ply.
+  static const int ONE_PLY = 4;
+  static const int CHECK_EXT = ONE_PLY;
+  static const int RECAPTURE_EXT = ONE_PLY / 2;
+  static const int PAWN_7TH_EXT = 3 * ONE_PLY / 4;
+  static const int SINGLE_REPLY_EXT = ONE_PLY;
+
+  // The depth of the iteration underway, which bounds the total
+  // extension along any path.
+  int root_depth;
+
+  // Return on a depth adjustment for a position in fractions of a ply.
   int depth_adjustment (const Board &b, Move m, int ply);
 
+  // Add frac to the extension carried to ply + 1 and return the whole
+  // plies by which to extend its search, within the path's budget.
+  int extend (int ply, int frac);
+
   ////////////////
   // Heuristics //
   ////////////////
@@ -344,10 +517,6 @@ struct Search_Engine {
   uint64 mates_table[64][64];
   uint64 mates_max;
 
-  Move killers[MAX_PLY];
-  Move killers2[MAX_PLY];
-  Move mate_killer[MAX_PLY];
-
   // Routines to update these heuristic tables.
   void collect_move (int depth, int ply, const Move &m, Score s);
   void collect_fail_high (int ply, const Move &m, Score s, int mi);
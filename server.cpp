@@ -0,0 +1,653 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// server.cpp                                                                 //
+//                                                                            //
+// An analysis server accepting many concurrent clients over a Unix domain    //
+// socket. Each client has its own position and game history. Searches are    //
+// queued to a shared pool of worker threads, each owning a search engine,    //
+// while the move generation tables are shared read only by every thread.     //
+//                                                                            //
+// The protocol is line oriented:                                             //
+//                                                                            //
+//   position startpos [moves <calg> ...]                                     //
+//   position fen <fen> [moves <calg> ...]                                    //
+//   go [depth <d>] [nodes <n>] [movetime <ms>]                               //
+//   stop                                                                     //
+//   new                                                                      //
+//   ping [<token>]                                                           //
+//   quit                                                                     //
+//                                                                            //
+// Each "go" is answered by exactly one line, either                          //
+//                                                                            //
+//   move <calg> score <cp> depth <ply> nodes <n> pv <calg> ...               //
+//                                                                            //
+// or "error <message>". A "go" with no limits runs until "stop", and no      //
+// search runs longer than the server's time limit, so that a few clients    //
+// cannot hold every worker. Replies are queued and written by the accepting  //
+// thread as each socket accepts them, so a slow client delays nobody else.   //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "chesley.hpp"
+
+using namespace std;
+
+struct Client;
+
+// A search requested by a client.
+struct Search_Job {
+  shared_ptr <Client> client;
+  Board board;
+  Search_Engine::Rep_Table history;
+  int depth;
+  int64 nodes;
+  int movetime;
+
+  // The following are protected by the client's mutex.
+  Search_Engine *engine; // Engine running this job, or NULL if queued.
+  bool stopped;          // Set if the client asked to stop this search.
+};
+
+// The state of one connected client.
+struct Client {
+
+  Client (int fd) : fd (fd) { reset (); }
+
+  // The descriptor is only closed once no worker refers to this client.
+  ~Client () { close (fd); }
+
+  // Return to the initial position with an empty game history.
+  void reset () {
+    board = Board::startpos ();
+    history.clear ();
+  }
+
+  // Queue a line for the accepting thread to write to the client. The
+  // caller must hold m.
+  void send_line (const string &line) {
+    output += line;
+    output += '\n';
+  }
+
+  // Write as much queued output as the socket takes without blocking,
+  // returning false if the client has gone away. The caller must hold
+  // m.
+  bool flush () {
+    while (!output.empty ())
+      {
+        ssize_t n = write (fd, output.data (), output.length ());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) return false;
+        output.erase (0, n);
+      }
+    return true;
+  }
+
+  const int fd;
+  string input;
+  string output;
+
+  // Game state. These are only touched by the accepting thread.
+  Board board;
+  Search_Engine::Rep_Table history;
+
+  // The search underway for this client, if any, and a lock
+  // protecting it and the queued output.
+  shared_ptr <Search_Job> job;
+  mutex m;
+};
+
+struct Server {
+
+  Server (int nthreads, int max_time) :
+    nthreads (max (nthreads, 1)), max_time (max_time), closing (false) {}
+
+  // Start the worker threads.
+  void start ();
+
+  // Stop every search and wait for the worker threads to exit.
+  void finish ();
+
+  // Accept and serve clients on listen_fd until the server is asked to
+  // shut down, returning false if polling fails.
+  bool run (int listen_fd);
+
+  // Wake the accepting thread so that it writes queued output.
+  void wake ();
+
+  // Execute a command line from a client, returning false if the
+  // client should be disconnected.
+  bool execute (const shared_ptr <Client> &c, const string &line);
+
+  // Commands.
+  void set_position (Client &c, const string_vector &tokens);
+  void go (const shared_ptr <Client> &c, const string_vector &tokens);
+  void stop (Client &c);
+
+  // Body of each worker thread.
+  void worker ();
+
+  // Search for a job, returning a line to send to its client.
+  string search (Search_Engine &se, const Search_Job &job);
+
+  const int nthreads;
+
+  // The longest any search may run, in milliseconds.
+  const int max_time;
+
+  // Connected clients, indexed by descriptor.
+  map <int, shared_ptr <Client> > clients;
+
+  // Queued searches, protected by m.
+  deque <shared_ptr <Search_Job> > queue;
+  bool closing;
+
+  mutex m;
+  condition_variable cv;
+  vector <thread> threads;
+};
+
+// Games longer than this are refused since the repetition table is
+// bounded.
+static const int MAX_GAME_LENGTH = 500;
+
+// Clients which let more output than this pile up are disconnected.
+static const size_t MAX_OUTPUT = 1024 * 1024;
+
+// A pipe written to wake the accepting thread, by the workers when
+// they queue a reply and by the signal handler on shutdown.
+static int wake_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t shutting_down = 0;
+
+static void
+on_shutdown (int) {
+  shutting_down = 1;
+  if (write (wake_pipe[1], "", 1) < 0) {}
+}
+
+///////////////////////
+// Command execution //
+///////////////////////
+
+bool
+Server :: execute (const shared_ptr <Client> &c, const string &line) {
+  string_vector tokens = tokenize (line);
+  if (tokens.size () == 0) return true;
+
+  const string &cmd = tokens[0];
+
+  if (cmd == "position")
+    {
+      set_position (*c, tokens);
+    }
+  else if (cmd == "go")
+    {
+      go (c, tokens);
+    }
+  else if (cmd == "stop")
+    {
+      stop (*c);
+    }
+  else if (cmd == "new")
+    {
+      stop (*c);
+      c -> reset ();
+    }
+  else if (cmd == "ping")
+    {
+      unique_lock <mutex> lock (c -> m);
+      c -> send_line ("pong" + (tokens.size () > 1 ? " " + tokens[1] : ""));
+    }
+  else if (cmd == "quit")
+    {
+      return false;
+    }
+  else
+    {
+      unique_lock <mutex> lock (c -> m);
+      c -> send_line ("error unknown command " + cmd);
+    }
+
+  return true;
+}
+
+// Set up a position and play any moves following it. The client's
+// state is left unchanged if any part of the command is invalid.
+void
+Server :: set_position (Client &c, const string_vector &tokens) {
+  size_t i = 1;
+  Board b;
+  string error;
+
+  // Parse the initial position.
+  if (tokens.size () > 1 && tokens[1] == "startpos")
+    {
+      b = Board::startpos ();
+      i = 2;
+    }
+  else if (tokens.size () > 2 && tokens[1] == "fen")
+    {
+      string_vector fen;
+      for (i = 2; i < tokens.size () && tokens[i] != "moves"; i++)
+        fen.push_back (tokens[i]);
+
+      try
+        {
+          b = Board::from_fen (fen);
+          if (!b.is_valid ())
+            error = "illegal position";
+        }
+      catch (string e)
+        {
+          error = e;
+        }
+    }
+  else
+    {
+      error = "expected startpos or fen";
+    }
+
+  // Play out the move list, recording each position for repetition
+  // detection.
+  Search_Engine::Rep_Table history;
+  int moves = 0;
+
+  if (error.empty () && i < tokens.size ())
+    {
+      if (tokens[i] != "moves")
+        error = "expected moves";
+
+      for (i++; error.empty () && i < tokens.size (); i++)
+        {
+          Move m = b.legal_from_calg (tokens[i]);
+          if (m == NULL_MOVE)
+            error = "illegal move " + tokens[i];
+          else if (++moves > MAX_GAME_LENGTH)
+            error = "game too long";
+          else
+            {
+              b.apply (m);
+              history[b.hash]++;
+            }
+        }
+    }
+
+  if (!error.empty ())
+    {
+      unique_lock <mutex> lock (c.m);
+      c.send_line ("error " + error);
+      return;
+    }
+
+  c.board = b;
+  c.history = history;
+}
+
+// Queue a search of the client's current position.
+void
+Server :: go (const shared_ptr <Client> &c, const string_vector &tokens) {
+  shared_ptr <Search_Job> job (new Search_Job ());
+  job -> client = c;
+  job -> board = c -> board;
+  job -> history = c -> history;
+  job -> depth = -1;
+  job -> nodes = -1;
+  job -> movetime = -1;
+  job -> engine = NULL;
+  job -> stopped = false;
+
+  for (size_t i = 1; i + 1 < tokens.size (); i += 2)
+    {
+      if (tokens[i] == "depth")
+        job -> depth = to_int (tokens[i + 1]);
+      else if (tokens[i] == "nodes")
+        job -> nodes = atoll (tokens[i + 1].c_str ());
+      else if (tokens[i] == "movetime")
+        job -> movetime = to_int (tokens[i + 1]);
+    }
+
+  {
+    unique_lock <mutex> lock (c -> m);
+    if (c -> job)
+      {
+        c -> send_line ("error search in progress");
+        return;
+      }
+    c -> job = job;
+  }
+
+  unique_lock <mutex> lock (m);
+  queue.push_back (job);
+  cv.notify_one ();
+}
+
+// Stop the client's search, if any. A search which has not yet
+// started still completes one iteration so that a move is returned.
+void
+Server :: stop (Client &c) {
+  unique_lock <mutex> lock (c.m);
+  if (c.job)
+    {
+      c.job -> stopped = true;
+      if (c.job -> engine)
+        c.job -> engine -> stop = true;
+    }
+}
+
+////////////////////
+// Worker threads //
+////////////////////
+
+void
+Server :: start () {
+  for (int i = 0; i < nthreads; i++)
+    threads.push_back (thread (&Server::worker, this));
+}
+
+void
+Server :: finish () {
+  map <int, shared_ptr <Client> > :: iterator i;
+  for (i = clients.begin (); i != clients.end (); i++)
+    stop (*i -> second);
+
+  {
+    unique_lock <mutex> lock (m);
+    closing = true;
+    cv.notify_all ();
+  }
+
+  for (size_t j = 0; j < threads.size (); j++)
+    threads[j].join ();
+  threads.clear ();
+}
+
+void
+Server :: worker () {
+  Search_Engine *se = new Search_Engine ();
+  se -> session_poll = false;
+  se -> post = false;
+
+  while (true)
+    {
+      shared_ptr <Search_Job> job;
+
+      {
+        unique_lock <mutex> lock (m);
+        while (queue.empty () && !closing)
+          cv.wait (lock);
+        if (queue.empty ())
+          break;
+        job = queue.front ();
+        queue.pop_front ();
+      }
+
+      Client &c = *job -> client;
+
+      {
+        unique_lock <mutex> lock (c.m);
+        job -> engine = se;
+        se -> stop = job -> stopped;
+      }
+
+      string result = search (*se, *job);
+
+      {
+        unique_lock <mutex> lock (c.m);
+        c.send_line (result);
+        job -> engine = NULL;
+        c.job.reset ();
+      }
+
+      wake ();
+    }
+
+  delete se;
+}
+
+void
+Server :: wake () {
+  if (write (wake_pipe[1], "", 1) < 0) {}
+}
+
+// Configure the engine for a job's limits and search its position.
+string
+Server :: search (Search_Engine &se, const Search_Job &job) {
+  Board b = job.board;
+  Move_Vector pv;
+  Score score;
+
+  // There is nothing to search if the game is over.
+  Search_Engine::Rep_Table::const_iterator rep = job.history.find (b.hash);
+  if (b.child_count () == 0 ||
+      (rep != job.history.end () && rep -> second >= 3))
+    {
+      score = b.in_check (b.to_move ()) ? -MATE_VAL : 0;
+      return "move none score " + to_string (score) + " depth 0 nodes 0 pv";
+    }
+
+  // Every search is bounded in time, including one the client asked
+  // to run until stopped.
+  if (job.movetime > 0)
+    se.set_fixed_time (min (job.movetime, max_time));
+  else
+    se.set_fixed_time (max_time);
+  se.set_fixed_depth (job.depth);
+  se.set_fixed_nodes (job.nodes);
+  se.rt = job.history;
+
+  try
+    {
+      score = se.compute_pv (b, MAX_DEPTH, pv);
+    }
+  catch (string e)
+    {
+      return "error " + e;
+    }
+
+  return se.summary (b, score, pv);
+}
+
+/////////////////////////
+// Connection handling //
+/////////////////////////
+
+bool
+Server :: run (int listen_fd) {
+  char buf[4096];
+
+  while (!shutting_down)
+    {
+      // Wait for a new connection, a wake up, input from any client or
+      // room to write output queued for one.
+      vector <struct pollfd> fds (2);
+      fds[0].fd = listen_fd;
+      fds[0].events = POLLIN;
+      fds[0].revents = 0;
+      fds[1].fd = wake_pipe[0];
+      fds[1].events = POLLIN;
+      fds[1].revents = 0;
+
+      map <int, shared_ptr <Client> > :: iterator i;
+      for (i = clients.begin (); i != clients.end (); i++)
+        {
+          unique_lock <mutex> lock (i -> second -> m);
+          struct pollfd p;
+          p.fd = i -> first;
+          p.events = POLLIN | (i -> second -> output.empty () ? 0 : POLLOUT);
+          p.revents = 0;
+          fds.push_back (p);
+        }
+
+      if (::poll (&fds[0], fds.size (), -1) < 0)
+        {
+          if (errno == EINTR) continue;
+          perror ("poll");
+          return false;
+        }
+
+      // Empty the wake up pipe. Queued output is written below.
+      if (fds[1].revents & POLLIN)
+        while (read (wake_pipe[0], buf, sizeof (buf)) > 0);
+
+      // Accept a new client. Its socket never blocks, so that a client
+      // which is slow to read cannot hold up the server.
+      if (fds[0].revents & POLLIN)
+        {
+          int fd = accept (listen_fd, NULL, NULL);
+          if (fd >= 0)
+            {
+              fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+              clients[fd] = shared_ptr <Client> (new Client (fd));
+            }
+        }
+
+      // Read and execute complete lines from each client, then write
+      // whatever output it has waiting.
+      for (size_t j = 2; j < fds.size (); j++)
+        {
+          shared_ptr <Client> c = clients[fds[j].fd];
+          bool connected = true;
+
+          if (fds[j].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+              ssize_t n = read (c -> fd, buf, sizeof (buf));
+              connected = n > 0 ||
+                (n < 0 && (errno == EINTR || errno == EAGAIN));
+
+              if (n > 0)
+                c -> input.append (buf, n);
+            }
+
+          size_t eol;
+          while (connected && (eol = c -> input.find ('\n')) != string::npos)
+            {
+              string line = trim (c -> input.substr (0, eol));
+              c -> input.erase (0, eol + 1);
+              connected = execute (c, line);
+            }
+
+          // Refuse clients sending unreasonably long lines.
+          if (c -> input.length () > 64 * 1024)
+            connected = false;
+
+          if (connected)
+            {
+              unique_lock <mutex> lock (c -> m);
+              connected = c -> flush () && c -> output.length () < MAX_OUTPUT;
+            }
+
+          if (!connected)
+            {
+              stop (*c);
+              clients.erase (c -> fd);
+            }
+        }
+    }
+
+  return true;
+}
+
+// Entry point for "chesley server".
+int
+server_main (int argc, char **argv) {
+  string path;
+  int threads = 1;
+  int max_time = 60 * 1000;
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      if (arg == "--socket" && i + 1 < argc)
+        {
+          path = argv[++i];
+        }
+      else if (arg == "--threads" && i + 1 < argc)
+        {
+          threads = atoi (argv[++i]);
+        }
+      else if (arg == "--max-time" && i + 1 < argc)
+        {
+          max_time = max (atoi (argv[++i]), 1);
+        }
+      else
+        {
+          path.clear ();
+          break;
+        }
+    }
+
+  struct sockaddr_un addr;
+  memset (&addr, 0, sizeof (addr));
+
+  if (path.empty () || path.length () >= sizeof (addr.sun_path))
+    {
+      fprintf (stderr, "usage: %s server --socket PATH [--threads T] "
+               "[--max-time MS]\n", arg0);
+      return 1;
+    }
+
+  // Writing to a client which has gone away should not kill the
+  // server.
+  signal (SIGPIPE, SIG_IGN);
+
+  // Shut down cleanly on an interrupt or termination request.
+  if (pipe (wake_pipe) < 0)
+    {
+      perror ("pipe");
+      return 1;
+    }
+  for (int i = 0; i < 2; i++)
+    fcntl (wake_pipe[i], F_SETFL, fcntl (wake_pipe[i], F_GETFL) | O_NONBLOCK);
+  signal (SIGINT, on_shutdown);
+  signal (SIGTERM, on_shutdown);
+
+  int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path.c_str ());
+  unlink (path.c_str ());
+
+  if (fd < 0 ||
+      bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+      listen (fd, 64) < 0)
+    {
+      perror (path.c_str ());
+      return 1;
+    }
+
+  fprintf (stderr, "listening on %s with %i threads\n",
+           path.c_str (), max (threads, 1));
+
+  Server server (threads, max_time);
+  server.start ();
+  bool ok = server.run (fd);
+  server.finish ();
+
+  close (fd);
+  unlink (path.c_str ());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// server.hpp                                                                 //
+//                                                                            //
+// An analysis server accepting many concurrent clients over a Unix domain    //
+// socket.                                                                    //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SERVER_
+#define _SERVER_
+
+// Entry point for "chesley server --socket PATH [--threads T]". Each
+// connection has its own position and game history while searches
+// from every connection share a pool of T worker threads, each of
+// which owns a search engine and its hash tables.
+int server_main (int argc, char **argv);
+
+#endif // _SERVER_
@@ -53,7 +53,6 @@ Search_Engine Session::se;
 // Engine state.
 bool        Session::running;
 bool        Session::interrupt_on_io = true;
-bool        Session::ponder_enabled = false;
 const char *Session::prompt;
 
 ////////////////////////////////
@@ -73,7 +72,7 @@ Session::init_session () {
   running = false;
 
   // Set initial search state.
-  se = Search_Engine ();
+  se.reset ();
   se.post = true;
 
   // Setup I/O.
@@ -158,7 +157,7 @@ Session::work ()
   // If it isn't our turn, possibly ponder then return.
   if (board.to_move () != our_color)
     {
-      if (ponder_enabled && pv.count >= 2)
+      if (se.ponder_enabled && pv.count >= 2)
         {
           Board to_ponder = board;
 
@@ -59,9 +59,6 @@ struct Session {
   // Should we interupt the search if we have pending input?
   static bool interrupt_on_io;
 
-  // Is pondering enabled?
-  static bool ponder_enabled;
-
   // Command prompt.
   static const char *prompt;
 
@@ -151,8 +148,20 @@ struct Session {
 
   // ??? Move implementations to commands.cpp?
 
+  // Annotate the games in a PGN file.
+  static bool annotate (const string_vector &tokens);
+
   // Process a string in Extended Position Notation.
-  static bool epd (const string_vector &tokens);
+  static bool epd (String_View args);
+
+  // Analyze the positions in an EPD file, writing a new EPD file.
+  static bool epd_analyze (const string_vector &tokens);
+
+  // Search for a mate in the current position.
+  static bool mate (const string_vector &tokens);
+
+  // Mine tactical puzzles from a PGN file.
+  static bool puzzles (const string_vector &tokens);
 
   // Set up time controls from level command.
   static bool level (const string_vector &tokens);
@@ -178,6 +187,16 @@ struct Session {
 
   // Check that hash keys are correctly generated to depth 'd'.
   static void test_hashing (int d);
+
+  // Time FEN parsing through views against parsing through tokens.
+  static bool fen_bench (const string_vector &tokens);
+
+  // Time move application by copy and by apply and unapply.
+  static bool apply_bench (const string_vector &tokens);
+
+  // Replay the games in a PGN file under each apply policy, checking
+  // they reach the same positions and timing each.
+  static bool replay_test (const string_vector &tokens);
 };
 
 #endif // _Session_
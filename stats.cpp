@@ -204,7 +204,7 @@ gen_material_stats (const string filename)
     {
       Game g = pgn.read_game ();
       if (pgn.status == PGN::END_OF_FILE) break;
-      if (g.winner == NULL_COLOR) continue;
+      if (!g.finished || g.winner == NULL_COLOR) continue;
 
       Board b = Board::startpos ();
       int stable_count = 0;
@@ -241,7 +241,9 @@ gen_material_stats (const string filename)
                 }
             }
 
-          if (!b.apply (g.moves[i])) break;
+          // Only material is counted, and the moves were checked as
+          // they were read.
+          b.apply <APPLY_PLACEMENT> (g.moves[i]);
         }
     }
 
@@ -337,17 +339,20 @@ private:
         g = pgn.read_game ();
         if (pgn.status == PGN::END_OF_FILE) break;
 
+        // A game without a result says nothing about its positions.
+        if (!g.finished) continue;
+
         Board b = Board::startpos ();
         for (uint32 i = 0; i < g.moves.size (); i++)
           {
             collect_features (b, g);
-            if (!b.apply (g.moves[i])) break;
+            b.apply <APPLY_PLACEMENT> (g.moves[i]);
           }
       }
   }
 
   // Collect features of a position.
-  void collect_features (const Board &b, Game g) {
+  void collect_features (const Board &b, const Game &g) {
 
     //    if (abs(b.material[WHITE] - b.material[BLACK]) > 0)
     //      return;
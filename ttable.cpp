@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// ttable.cpp                                                                 //
+//                                                                            //
+// Attaching a transposition table to a POSIX shared memory segment. The     //
+// segment begins with a small header recording the number of entries,       //
+// followed by the entries themselves. Entries are written without locks;    //
+// see TTable :: load () for how torn writes are detected.                   //
+//                                                                            //
+// Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
+// the Chess Engine! is free software distributed under the terms of the      //
+// GNU Public License.                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chesley.hpp"
+
+using namespace std;
+
+// The check in TTable :: load () covers exactly four words.
+static_assert (sizeof (TTable::Entry) == 4 * sizeof (uint64),
+               "TTable::Entry must be 32 bytes long");
+
+// Written last by the process creating a segment, once it is ready.
+static const uint64 SHM_MAGIC = 0x4348455354544231ULL;
+
+// The header at the start of a segment. It is padded to a cache line
+// so that the entries which follow are aligned.
+struct Shm_Header {
+  volatile uint64 magic;
+  uint64 entries;
+  byte pad[48];
+};
+
+// Shared memory object names must begin with a slash.
+static string
+shm_name (const char *name) {
+  return name[0] == '/' ? string (name) : "/" + string (name);
+}
+
+void
+TTable :: attach (const char *name, size_t entries) {
+  string path = shm_name (name);
+  size_t bytes = sizeof (Shm_Header) + entries * sizeof (Entry);
+  bool created = true;
+
+  // Try to create the segment, and otherwise open the existing one.
+  int fd = shm_open (path.c_str (), O_RDWR | O_CREAT | O_EXCL, 0666);
+  if (fd < 0 && errno == EEXIST)
+    {
+      created = false;
+      fd = shm_open (path.c_str (), O_RDWR, 0666);
+    }
+  if (fd < 0)
+    throw string ("shm_open ") + path + ": " + strerror (errno);
+
+  if (created)
+    {
+      if (ftruncate (fd, bytes) < 0)
+        {
+          string err = strerror (errno);
+          close (fd);
+          shm_unlink (path.c_str ());
+          throw string ("ftruncate ") + path + ": " + err;
+        }
+    }
+  else
+    {
+      // Wait briefly for the creator to size the segment and write its
+      // header, then adopt whatever size it chose.
+      off_t size = 0;
+      for (int i = 0; i < 1000; i++)
+        {
+          struct stat st;
+          if (fstat (fd, &st) == 0)
+            size = st.st_size;
+          if (size >= (off_t) sizeof (Shm_Header))
+            break;
+          usleep (1000);
+        }
+      if (size < (off_t) sizeof (Shm_Header))
+        {
+          close (fd);
+          throw string ("shared table ") + path + " was never initialized";
+        }
+      bytes = size;
+    }
+
+  void *base = mmap (NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    throw string ("mmap ") + path + ": " + strerror (errno);
+
+  Shm_Header *h = (Shm_Header *) base;
+  if (created)
+    {
+      // The new segment is zero filled, which is an empty table.
+      numa_place (base, bytes);
+      h -> entries = entries;
+      __sync_synchronize ();
+      h -> magic = SHM_MAGIC;
+    }
+  else
+    {
+      for (int i = 0; i < 1000 && h -> magic != SHM_MAGIC; i++)
+        usleep (1000);
+      __sync_synchronize ();
+      if (h -> magic != SHM_MAGIC ||
+          sizeof (Shm_Header) + h -> entries * sizeof (Entry) > bytes)
+        {
+          munmap (base, bytes);
+          throw string ("shared table ") + path + " is not a valid table";
+        }
+      entries = h -> entries;
+    }
+
+  // Give up the private table, or any other segment.
+  if (shm)
+    release ();
+  else
+    numa_free (table, sz * sizeof (Entry));
+
+  shm = base;
+  shm_bytes = bytes;
+  table = (Entry *) (h + 1);
+  sz = entries;
+  owner = (uint32) getpid ();
+  clear_statistics ();
+}
+
+void
+TTable :: detach () {
+  if (!shm)
+    return;
+
+  release ();
+  table = (Entry *) numa_alloc (sz * sizeof (Entry));
+  clear_statistics ();
+}
+
+void
+TTable :: release () {
+  munmap (shm, shm_bytes);
+  shm = NULL;
+  shm_bytes = 0;
+  owner = 0;
+  table = NULL;
+}
+
+bool
+TTable :: unlink (const char *name) {
+  return shm_unlink (shm_name (name).c_str ()) == 0;
+}
@@ -1,7 +1,9 @@
 ////////////////////////////////////////////////////////////////////////////////
-// ttable.cpp                                                                 //
+// ttable.hpp                                                                 //
 //                                                                            //
-// The transposition table data type.                                         //
+// The transposition table data type. A table is either private to its        //
+// engine or attached to a named POSIX shared memory segment used by          //
+// several processes at once.                                                 //
 //                                                                            //
 // Copyright Matthew Gingell <matthewgingell@gmail.com>, 2009-2015. Chesley   //
 // the Chess Engine! is free software distributed under the terms of the      //
@@ -13,59 +15,120 @@
 #define _TTABLE_
 
 #include <cassert>
+#include <cstring>
 #include <stdlib.h>
 
 #include "common.hpp"
 #include "move.hpp"
+#include "numa.hpp"
 
 struct TTable
 {
   // Initialize the table.
   TTable (size_t sz) :
-    sz (sz), hits (0), misses (0), writes (0), collisions (0) {
-    table = (Entry *) calloc (sz, sizeof (Entry));
+    sz (sz), shm (NULL), shm_bytes (0), owner (0),
+    hits (0), misses (0), writes (0), collisions (0), shared_hits (0) {
+    table = (Entry *) numa_alloc (sz * sizeof (Entry));
   }
 
-  // An entry in the hash table.
+  // Release the table.
+  ~TTable () {
+    if (shm)
+      release ();
+    else
+      numa_free (table, sz * sizeof (Entry));
+  }
+
+  // Marks an entry without a static evaluation.
+  static const Score NO_EVAL = -32768;
+
+  // An entry in the hash table. The key is stored XORed with the
+  // words following it, so an entry torn by a concurrent write from
+  // another process fails to match any position and is ignored.
   struct Entry {
     hash_t key;    // :64
     Move   move;   // :32
     Score  score;  // :16
     int    depth   : 8;
     SKind  skind   : 8;
-    byte   pad[16];
+    int16  eval;   // Static evaluation, or NO_EVAL.
+    uint32 owner;  // Process which wrote the entry.
+    byte   pad[8];
   };
 
-  // Clear the entire table.
+  // Clear the entire table. A shared table is left alone, since other
+  // processes are still using it.
   void clear () {
-    memset (table, 0, sz * sizeof (Entry));
-    hits = misses = collisions = writes = 0;
+    if (!shm)
+      memset (table, 0, sz * sizeof (Entry));
+    clear_statistics ();
   }
 
-  // Set an entry by key.
+  // Replace the private table by the shared memory segment called
+  // name, creating one of sz entries if it does not already exist.
+  // Throws a string on failure.
+  void attach (const char *name, size_t sz);
+
+  // Return to a private table of the same size, leaving the shared
+  // segment in place for other processes.
+  void detach ();
+
+  // Remove a shared memory segment by name.
+  static bool unlink (const char *name);
+
+  // Is this table attached to a shared memory segment?
+  bool is_shared () const {
+    return shm != NULL;
+  }
+
+  // Set an entry by key. A static evaluation already stored for this
+  // position is kept unless a new one is given.
   void set
-  (const Board &b, SKind k, Move m, Score s, int d) {
-    Entry &e = table[b.hash % sz];
+  (const Board &b, SKind k, Move m, Score s, int d, Score eval = NO_EVAL) {
+    Entry e;
+    bool found = load (b.hash, e);
 
     // Collect statistics.
     writes++;
-    if (e.key != 0 && e.key != b.hash)
+    if (!found && e.key != 0)
       collisions++;
 
-    e.key = b.hash;
-    e.move = m;
-    e.score = s;
-    e.depth = d;
-    e.skind = k;
+    Entry n = Entry ();
+    n.move = m;
+    n.score = s;
+    n.depth = d;
+    n.skind = k;
+    n.eval = (found && eval == NO_EVAL) ? e.eval : eval;
+    n.owner = owner;
+    store (b.hash, n);
+  }
+
+  // Store an entry taken from another table, unless this table holds
+  // a deeper search of the same position.
+  void import (const Entry &n) {
+    Entry e;
+    if (!load (n.key, e) || n.depth >= e.depth)
+      store (n.key, n);
+  }
+
+  // Fetch the entry for a key with the key in the clear, returning
+  // false if there is none.
+  bool fetch (hash_t key, Entry &e) const {
+    if (!load (key, e))
+      return false;
+    e.key = key;
+    return true;
   }
 
   // Find an entry by key.
   SKind
   lookup (const Board &b, Move &m, Score &s, int &d) {
-    Entry &e = table[b.hash % sz];
-    if (e.key == b.hash && e.skind != NULL_SKIND)
+    Entry e;
+    if (load (b.hash, e))
       {
         hits++;
+        if (e.owner != owner)
+          shared_hits++;
         m = e.move;
         s = e.score;
         d = e.depth;
@@ -83,10 +146,12 @@ struct TTable
 
   // Fetch the move, if any, associated with this position.
   Move get_move (const Board &b) {
-    Entry &e = table[b.hash % sz];
-    if (e.key == b.hash && e.skind != NULL_SKIND)
+    Entry e;
+    if (load (b.hash, e))
       {
         hits++;
+        if (e.owner != owner)
+          shared_hits++;
         return e.move;
       }
     else
@@ -96,9 +161,15 @@ struct TTable
     return NULL_MOVE;
   }
 
+  // Fetch the static evaluation stored with this position, or NO_EVAL.
+  Score get_eval (const Board &b) const {
+    Entry e;
+    return load (b.hash, e) ? e.eval : NO_EVAL;
+  }
+
   // Clear statistics.
   void clear_statistics () {
-    hits = misses = writes = collisions = 0;
+    hits = misses = writes = collisions = shared_hits = 0;
   }
 
   // Return true is nothing is stored in a table slot.
@@ -106,15 +177,54 @@ struct TTable
     return (table[b.hash % sz].key == 0);
   }
 
+private:
+
+  // Return the XOR of the words following the key in an entry.
+  static uint64 check (const Entry &e) {
+    uint64 w[4];
+    memcpy (w, &e, sizeof (w));
+    return w[1] ^ w[2] ^ w[3];
+  }
+
+  // Copy out the slot for key, returning true if it holds a valid
+  // entry for that key. Each slot is copied once, so a write racing
+  // with the copy is caught by the check.
+  bool load (hash_t key, Entry &e) const {
+    memcpy ((void *) &e, &table[key % sz], sizeof (Entry));
+    return e.skind != NULL_SKIND && (e.key ^ check (e)) == key;
+  }
+
+  // Write an entry to the slot for key.
+  void store (hash_t key, Entry n) {
+    n.key = key ^ check (n);
+    memcpy ((void *) &table[key % sz], &n, sizeof (Entry));
+  }
+
+  // Unmap the shared segment.
+  void release ();
+
+  // Tables own their storage and are not copied.
+  TTable (const TTable &);
+  TTable &operator= (const TTable &);
+
+public:
+
   // Data.
   size_t sz;
   Entry *table;
 
+  // The shared segment, if any, its size in bytes and the tag written
+  // to entries stored by this process.
+  void *shm;
+  size_t shm_bytes;
+  uint32 owner;
+
   // Statistics.
   uint64 hits;
   uint64 misses;
   uint64 writes;
   uint64 collisions;
+  uint64 shared_hits;  // Hits on entries written by other processes.
 };
 
 #endif // _TTABLE_
@@ -11,11 +11,17 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
-#if 0
+#include <iostream>
+#include <string>
 
 #include "common.hpp"
 #include "util.hpp"
 
+// The name this program was invoked as.
+char *arg0;
+
+#if 0
+
 ///////////////////////////////
 // Random number generation  //
 ///////////////////////////////
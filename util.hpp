@@ -22,6 +22,7 @@
 #include <vector>
 
 #ifndef _WIN32
+#include <time.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/select.h>
@@ -141,6 +142,10 @@ static uint64 mclock () IS_UNUSED;
 // Return the amount of CPU time used in milliseconds.
 static uint64 cpu_time () IS_UNUSED;
 
+// Return the amount of CPU time used by the calling thread in
+// milliseconds.
+static uint64 thread_cpu_time () IS_UNUSED;
+
 #ifdef _WIN32
 #define usleep(usecs) (Sleep (usecs / 1000))
 #endif // _WIN32
@@ -349,6 +354,93 @@ operator<< (std::ostream &os, const string_vector &in) {
   return os << join (in, ", ");
 }
 
+//////////////////
+// String views //
+//////////////////
+
+// A reference to a run of characters owned by someone else. Text can
+// be parsed through views in place, without copying or allocating.
+struct String_View {
+
+  String_View () : ptr (NULL), len (0) {}
+  String_View (const char *p, size_t n) : ptr (p), len (n) {}
+  String_View (const char *s) : ptr (s), len (strlen (s)) {}
+  String_View (const std::string &s) : ptr (s.data ()), len (s.length ()) {}
+
+  size_t size () const { return len; }
+  bool empty () const { return len == 0; }
+  const char *begin () const { return ptr; }
+  const char *end () const { return ptr + len; }
+  char operator[] (size_t i) const { return ptr[i]; }
+
+  // Return a copy of the viewed characters.
+  std::string str () const { return std::string (ptr, len); }
+
+  // Compare with s, ignoring case if fold is set.
+  bool equals (String_View s, bool fold = false) const {
+    if (len != s.len) return false;
+    for (size_t i = 0; i < len; i++)
+      if (fold ? (toupper ((unsigned char) ptr[i]) !=
+                  toupper ((unsigned char) s.ptr[i]))
+               : ptr[i] != s.ptr[i])
+        return false;
+    return true;
+  }
+
+  bool operator== (String_View s) const { return equals (s); }
+  bool operator!= (String_View s) const { return !equals (s); }
+
+  const char *ptr;
+  size_t len;
+};
+
+static inline std::ostream &
+operator<< (std::ostream &os, String_View s) {
+  return os.write (s.ptr, s.len);
+}
+
+// Remove and return the next token from s, splitting as tokenize
+// does on space or ';'. A field in double quotes is returned without
+// its quotes. Returns an empty view once s is exhausted.
+static inline String_View
+next_token (String_View &s) {
+  const char *i = s.begin (), *end = s.end ();
+
+  while (i < end && (isspace (*i) || *i == ';'))
+    i++;
+
+  const char *start = i;
+  if (i < end && *i == '\"')
+    {
+      start = ++i;
+      while (i < end && *i != '\"')
+        i++;
+      String_View token (start, i - start);
+      s = String_View (i < end ? i + 1 : end, end - (i < end ? i + 1 : end));
+      return token;
+    }
+
+  while (i < end && !isspace (*i) && *i != ';')
+    i++;
+
+  s = String_View (i, end - i);
+  return String_View (start, i - start);
+}
+
+// Parse a non-negative decimal integer, returning false if s is not
+// one.
+static inline bool
+parse_uint (String_View s, uint64 &n) {
+  if (s.empty ()) return false;
+  n = 0;
+  for (const char *i = s.begin (); i < s.end (); i++)
+    {
+      if (!isdigit (*i)) return false;
+      n = 10 * n + (*i - '0');
+    }
+  return true;
+}
+
 ///////////////////
 // I/O functions //
 ///////////////////
@@ -501,6 +593,21 @@ cpu_time () {
 #endif  // _WIN32
 }
 
+// Return the amount of CPU time used by the calling thread in
+// milliseconds.
+static uint64
+thread_cpu_time () {
+#ifndef _WIN32
+  struct timespec ts;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return
+    ((uint64) ts.tv_sec) * 1000
+    + ((uint64) ts.tv_nsec) / 1000000;
+#else // _WIN32
+  return cpu_time ();
+#endif  // _WIN32
+}
+
 ////////////////////////////
 // Generic sorting inline //
 ////////////////////////////